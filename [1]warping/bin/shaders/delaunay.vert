@@ -3,8 +3,7 @@
 in vec3 vertexPosition;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "funcs/frameData.glsl"
 
 void main() {
 	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
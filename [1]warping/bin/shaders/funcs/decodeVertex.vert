@@ -0,0 +1,19 @@
+// decoding of quantized attributes (see GeometryRenderer): positions come
+// normalized to [-1;+1] in the bounding box of the geometry, and normals are
+// octahedral encoded in xy; Shader::setBuffers sets these uniforms, the 
+// defaults leave non-quantized attributes as they are
+
+uniform vec3 positionScale = vec3(1.f);
+uniform vec3 positionOffset = vec3(0.f);
+uniform bool quantizedNormals = false;
+
+vec3 decodePosition(vec3 p) {
+	return p*positionScale + positionOffset;
+}
+
+vec3 decodeNormal(vec3 n) {
+	if (!quantizedNormals) return n;
+	vec3 v = vec3(n.xy, 1.f-abs(n.x)-abs(n.y));
+	if (v.z<0.f) v.xy = (1.f-abs(v.yx)) * vec2(v.x>=0.f?1.f:-1.f, v.y>=0.f?1.f:-1.f);
+	return normalize(v);
+}
@@ -1,14 +1,14 @@
 # version 330 core
 
 // propiedades del material
-uniform vec3 diffuseColor;
-uniform float opacity;
+#include "funcs/materials.glsl"
 
 in float colorDecay;
 
 out vec4 fragColor;
 
 void main() {
+	MaterialData material = materials[materialIndex];
 	
-	fragColor = vec4(diffuseColor*colorDecay,opacity);
+	fragColor = vec4(material.diffuseColor*colorDecay,material.opacity);
 }
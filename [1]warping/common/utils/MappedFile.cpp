@@ -0,0 +1,71 @@
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile (const std::string &fname) {
+	file_handle = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+							  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle==INVALID_HANDLE_VALUE) { file_handle = nullptr; return; }
+	LARGE_INTEGER fsize;
+	if (not GetFileSizeEx(file_handle,&fsize) or fsize.QuadPart==0) { freeResources(); return; }
+	map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (not map_handle) { freeResources(); return; }
+	data_ptr = static_cast<const char*>(MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0));
+	if (not data_ptr) { freeResources(); return; }
+	data_size = static_cast<size_t>(fsize.QuadPart);
+}
+
+void MappedFile::freeResources ( ) {
+	if (data_ptr) UnmapViewOfFile(data_ptr);
+	if (map_handle) CloseHandle(map_handle);
+	if (file_handle) CloseHandle(file_handle);
+	data_ptr = nullptr; map_handle = file_handle = nullptr; data_size = 0;
+}
+
+#else
+
+MappedFile::MappedFile (const std::string &fname) {
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd==-1) return;
+	struct stat st;
+	if (fstat(fd,&st)==0 and st.st_size>0) {
+		void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p!=MAP_FAILED) {
+			data_ptr = static_cast<const char*>(p);
+			data_size = static_cast<size_t>(st.st_size);
+		}
+	}
+	close(fd); // the mapping keeps its own reference to the file
+}
+
+void MappedFile::freeResources ( ) {
+	if (data_ptr) munmap(const_cast<char*>(data_ptr),data_size);
+	data_ptr = nullptr; data_size = 0;
+}
+
+#endif
+
+MappedFile::MappedFile (MappedFile &&other) {
+	*this = static_cast<const MappedFile&>(other);
+	other = static_cast<const MappedFile&>(MappedFile());
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+	freeResources();
+	*this = static_cast<const MappedFile&>(other);
+	other = static_cast<const MappedFile&>(MappedFile());
+	return *this;
+}
+
+MappedFile::~MappedFile ( ) {
+	freeResources();
+}
+
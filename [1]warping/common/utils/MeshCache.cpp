@@ -0,0 +1,173 @@
+#include <fstream>
+#include <tuple>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "MeshCache.hpp"
+#include "MappedFile.hpp"
+#include "Debug.hpp"
+#include "Misc.hpp"
+
+namespace {
+
+const char cache_magic[4] = {'C','G','M','C'};
+const uint32_t cache_version = 1;
+
+std::string getCachePath(const std::string &obj_path) {
+	return obj_path+".mcache";
+}
+
+// sequential reader over the mapped file, it stops (and ok becomes false)
+// instead of reading past the end of a truncated/corrupt file
+struct CacheReader {
+	const char *p, *end;
+	bool ok = true;
+	CacheReader(const MappedFile &file) : p(file.begin()), end(file.end()) { }
+	void read(void *dst, size_t n) {
+		if (not ok or static_cast<size_t>(end-p)<n) { ok = false; return; }
+		std::memcpy(dst,p,n); p += n;
+	}
+	template<typename T> T get() { T v{}; read(&v,sizeof(T)); return v; }
+	std::string getString() {
+		uint32_t n = get<uint32_t>();
+		if (not ok or static_cast<size_t>(end-p)<n) { ok = false; return {}; }
+		std::string s(p,n); p += n;
+		return s;
+	}
+	template<typename T> void getVector(std::vector<T> &v) {
+		uint32_t n = get<uint32_t>();
+		if (not ok or static_cast<size_t>(end-p)/sizeof(T)<n) { ok = false; return; }
+		v.resize(n); read(v.data(),n*sizeof(T));
+	}
+};
+
+struct CacheWriter {
+	std::ofstream file;
+	CacheWriter(const std::string &path) : file(path,std::ios::binary|std::ios::trunc) { }
+	void write(const void *src, size_t n) { file.write(static_cast<const char*>(src),n); }
+	template<typename T> void put(const T &v) { write(&v,sizeof(T)); }
+	void putString(const std::string &s) {
+		put(static_cast<uint32_t>(s.size())); write(s.data(),s.size());
+	}
+	template<typename T> void putVector(const std::vector<T> &v) {
+		put(static_cast<uint32_t>(v.size())); write(v.data(),v.size()*sizeof(T));
+	}
+};
+
+void putMaterial(CacheWriter &w, const Material &m) {
+	w.put(m.ka); w.put(m.kd); w.put(m.ks); w.put(m.ke);
+	w.put(m.shininess); w.put(m.opacity);
+	w.putString(m.texture);
+}
+
+Material getMaterial(CacheReader &r) {
+	Material m;
+	m.ka = r.get<glm::vec3>(); m.kd = r.get<glm::vec3>();
+	m.ks = r.get<glm::vec3>(); m.ke = r.get<glm::vec3>();
+	m.shininess = r.get<float>(); m.opacity = r.get<float>();
+	m.texture = r.getString();
+	return m;
+}
+
+}
+
+MeshCache toMeshCache(const ObjMesh &obj) {
+	MeshCache cache;
+	std::tie(cache.pmin,cache.pmax) = getBoundingBox(obj.positions);
+	cache.parts.reserve(obj.parts.size());
+	for(const ObjMesh::Part &part : obj.parts)
+		cache.parts.push_back({part.name,part.material,toGeometry(obj,part)});
+	return cache;
+}
+
+bool readMeshCache(const std::string &obj_path, MeshCache &cache) {
+	MappedFile file(getCachePath(obj_path));
+	if (not file.isOk()) return false;
+
+	CacheReader r(file);
+	char magic[4];
+	r.read(magic,4);
+	if (not r.ok or std::memcmp(magic,cache_magic,4)!=0 or
+		r.get<uint32_t>()!=cache_version) return false;
+
+	// dependencies: the .obj itself and its .mtl files
+	uint32_t ndeps = r.get<uint32_t>();
+	for(uint32_t i=0; r.ok and i<ndeps; ++i) {
+		std::string dep_path = i==0 ? obj_path : r.getString();
+		long long mtime = r.get<long long>(), size = r.get<long long>(), cur_mtime, cur_size;
+		if (not getFileStamp(dep_path,cur_mtime,cur_size) or
+			cur_mtime!=mtime or cur_size!=size) return false;
+	}
+
+	MeshCache aux;
+	aux.pmin = r.get<glm::vec3>();
+	aux.pmax = r.get<glm::vec3>();
+	aux.parts.resize(r.get<uint32_t>());
+	for(MeshCache::Part &part : aux.parts) {
+		part.name = r.getString();
+		part.material = getMaterial(r);
+		r.getVector(part.geometry.positions);
+		r.getVector(part.geometry.normals);
+		r.getVector(part.geometry.tex_coords);
+		r.getVector(part.geometry.triangles);
+		if (not r.ok) break;
+	}
+	if (not r.ok or r.p!=r.end) {
+		cg_info("Ignoring corrupt mesh cache: " + getCachePath(obj_path));
+		return false;
+	}
+	cache = std::move(aux);
+	return true;
+}
+
+bool writeMeshCache(const std::string &obj_path, const ObjMesh &obj, const MeshCache &cache) {
+	std::vector<std::string> deps = { obj_path };
+	deps.insert(deps.end(),obj.material_libs.begin(),obj.material_libs.end());
+
+	// written with another name and then renamed, so another job loading the
+	// same model (see ModelLoader) never maps a partially written cache
+	std::string path = getCachePath(obj_path), tmp_path = getTempFileName(path);
+	CacheWriter w(tmp_path);
+	if (not w.file.is_open()) return false;
+	w.write(cache_magic,4);
+	w.put(cache_version);
+	w.put(static_cast<uint32_t>(deps.size()));
+	for(size_t i=0;i<deps.size();++i) {
+		long long mtime = 0, size = 0;
+		getFileStamp(deps[i],mtime,size);
+		if (i!=0) w.putString(deps[i]); // the .obj path is implicit
+		w.put(mtime); w.put(size);
+	}
+	w.put(cache.pmin); w.put(cache.pmax);
+	w.put(static_cast<uint32_t>(cache.parts.size()));
+	for(const MeshCache::Part &part : cache.parts) {
+		w.putString(part.name);
+		putMaterial(w,part.material);
+		w.putVector(part.geometry.positions);
+		w.putVector(part.geometry.normals);
+		w.putVector(part.geometry.tex_coords);
+		w.putVector(part.geometry.triangles);
+	}
+	w.file.close();
+	if (not w.file.good()) {
+		std::remove(tmp_path.c_str());
+		return false;
+	}
+	return replaceFile(tmp_path,path);
+}
+
+MeshCache loadMeshCache(const std::string &obj_path) {
+	MeshCache cache;
+	if (readMeshCache(obj_path,cache)) {
+		cg_info("Using mesh cache for: " + obj_path);
+		return cache;
+	}
+	ObjMesh obj = readObj(obj_path);
+	cache = toMeshCache(obj);
+	if (not writeMeshCache(obj_path,obj,cache)) {
+		cg_info("Could not write mesh cache for: " + obj_path);
+		std::remove(getCachePath(obj_path).c_str());
+	}
+	return cache;
+}
+
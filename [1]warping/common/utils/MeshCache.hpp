@@ -0,0 +1,36 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <vector>
+#include <string>
+#include <glm/vec3.hpp>
+#include "Geometry.hpp"
+#include "Material.hpp"
+#include "ObjMesh.hpp"
+
+// deduplicated geometry (already converted with toGeometry) of every part of
+// an .obj file; it is stored in a binary file next to the .obj (same name plus
+// ".mcache") so the text parsing is done only once
+struct MeshCache {
+	struct Part {
+		std::string name;
+		Material material;
+		Geometry geometry;
+	};
+	std::vector<Part> parts;
+	glm::vec3 pmin, pmax; // bounding box of all the positions in the .obj
+};
+
+MeshCache toMeshCache(const ObjMesh &obj);
+
+// reads the cache for obj_path, returns false if it does not exist or if it is
+// older than the .obj or any of its .mtl files
+bool readMeshCache(const std::string &obj_path, MeshCache &cache);
+
+bool writeMeshCache(const std::string &obj_path, const ObjMesh &obj, const MeshCache &cache);
+
+// uses the cache if it is fresh, otherwise parses the .obj and regenerates it
+MeshCache loadMeshCache(const std::string &obj_path);
+
+#endif
+
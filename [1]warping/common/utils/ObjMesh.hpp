@@ -3,11 +3,13 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include "ObjMesh.hpp"
 #include "Material.hpp"
 #include "Geometry.hpp"
+#include "MappedFile.hpp"
 
 struct ObjMesh {
 	
@@ -26,6 +28,7 @@ struct ObjMesh {
 		std::vector<Element> elements;
 	};
 	std::vector<Part> parts;
+	std::vector<std::string> material_libs; // full paths of the .mtl files used
 	
 	const Part &getPart(const std::string &name) const;
 	
@@ -37,4 +40,37 @@ Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part);
 Geometry toGeometry(const ObjMesh &obj, int ipart=0);
 Geometry toGeometry(const ObjMesh &obj, const std::string &name);
 
+// reads an .obj file in two passes over a memory mapping, for meshes too big
+// to build the whole ObjMesh and its Geometry in memory: the constructor loads
+// only the vertex attributes and the list of parts, then readFaces converts the
+// faces in windows of bounded size (that can be appended to a GeometryRenderer
+// and discarded); vertexes are shared only within the same window
+class ObjStream {
+public:
+	struct Part {
+		std::string name;
+		Material material;
+		size_t faces = 0;
+	};
+	std::vector<Part> parts;
+	// can be modified before calling readFaces (e.g. with centerAndResize)
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> tex_coords;
+	
+	ObjStream(const std::string &full_path);
+	
+	// replaces the normals from the file with per-position normals
+	void generateNormals();
+	
+	// callback(ipart,window) is called for every window, each one uses
+	// about memory_budget bytes at most
+	void readFaces(size_t memory_budget, const std::function<void(int,const Geometry&)> &callback) const;
+	
+private:
+	MappedFile file;
+	std::vector<size_t> part_starts; // file offset of the first line of each part
+	bool per_position_normals = false;
+};
+
 #endif
@@ -1,6 +1,7 @@
 #ifndef SHADERS_H
 #define SHADERS_H
 #include <string>
+#include <unordered_map>
 #include <glad/glad.h>
 #include <glm/ext/matrix_float4x4.hpp>
 #include "Material.hpp"
@@ -18,10 +19,16 @@ public:
 	void load(const std::string &fname);
 	void load(const std::string &vertex_fname, const std::string &fragment_fname);
 	
-	bool setBuffer (const char *name, GLuint buffer_id, GLenum type, int size, bool required=true);
+	bool setBuffer (const char *name, GLuint buffer_id, GLenum type, int size, bool required=true, GLsizei stride=0, size_t offset=0);
 	void setBuffers(const GeometryRenderer &geo);
+	// with shaders that include funcs/materials.glsl, only sets the index of
+	// the material in the MaterialTable (adding it if it is not there, so
+	// it is faster to give the index directly)
 	void setMaterial(const Material &mat);
+	void setMaterial(int material_index);
 	void setMatrixes(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection);
+	// only the model matrix (for shaders that take the others from FrameData)
+	void setModelMatrix(const glm::mat4 &model);
 	void setLight(const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength);
 	
 	bool setUniform(const char *name, float v);
@@ -29,6 +36,35 @@ public:
 	bool setUniform(const char *name, const glm::vec4 &v);
 	bool setUniform(const char *name, const glm::mat4 &v);
 	
+	// handles for setting uniforms and attributes without searching for their
+	// names each time: get them once (after loading) and keep them; a handle
+	// is invalid (isOk()==false) if the program does not use that name
+	template<typename T> struct Uniform {
+		GLint location = -1;
+		bool isOk() const { return location!=-1; }
+	};
+	struct Attribute {
+		GLint location = -1;
+		bool isOk() const { return location!=-1; }
+	};
+	template<typename T> Uniform<T> getUniform(const char *name) const {
+		++lookup_count;
+		return Uniform<T>{findUniform(name,glType(static_cast<T*>(nullptr)))};
+	}
+	Attribute getAttribute(const char *name) const;
+	
+	bool setUniform(Uniform<int> u, int v);
+	bool setUniform(Uniform<float> u, float v);
+	bool setUniform(Uniform<glm::vec3> u, const glm::vec3 &v);
+	bool setUniform(Uniform<glm::vec4> u, const glm::vec4 &v);
+	bool setUniform(Uniform<glm::mat4> u, const glm::mat4 &v);
+	
+	// number of searches by name (in any shader) since the last reset; the
+	// functions that do not get a name (setMatrixes, setMaterial, setLight,
+	// setBuffers and the ones that get handles) do not search
+	static int getLookupCount() { return lookup_count; }
+	static void resetLookupCount() { lookup_count = 0; }
+	
 	GLuint getProgramId() const { return program_id; }
 	
 	void use() const;
@@ -36,6 +72,71 @@ public:
 private:
 	Shader &operator=(const Shader &) = default;
 	GLuint program_id = 0;
+	
+	// active uniforms and attributes of the program, by name (filled when
+	// linking, arrays are also there without the "[0]")
+	struct Location { GLint location; GLenum type; };
+	std::unordered_map<std::string,Location> uniforms, attributes;
+	GLint findUniform(const char *name, GLenum type) const;
+	GLint findAttribute(const char *name) const;
+	static GLenum glType(int*) { return GL_INT; }
+	static GLenum glType(float*) { return GL_FLOAT; }
+	static GLenum glType(glm::vec3*) { return GL_FLOAT_VEC3; }
+	static GLenum glType(glm::vec4*) { return GL_FLOAT_VEC4; }
+	static GLenum glType(glm::mat4*) { return GL_FLOAT_MAT4; }
+	
+	// handles for the names used by setMatrixes, setMaterial, setLight and
+	// setBuffers
+	struct {
+		Uniform<glm::mat4> model_matrix, view_matrix, projection_matrix;
+		Uniform<glm::vec3> diffuse_color, specular_color, ambient_color, emission_color;
+		Uniform<float> opacity, shininess;
+		Uniform<int> material_index;
+		Uniform<glm::vec4> light_position;
+		Uniform<glm::vec3> light_color;
+		Uniform<float> ambient_strength;
+		Uniform<glm::vec3> position_scale, position_offset;
+		Uniform<float> quantized_normals;
+		Attribute vertex_position, vertex_normal, vertex_tex_coords;
+	} common;
+	void introspect();
+	
+	// values of the quantization uniforms in the program (see setBuffers)
+	struct {
+		glm::vec3 scale, offset;
+		float normals;
+		bool valid = false;
+	} quantization;
+	
+	static int lookup_count;
+};
+
+// data shared by all the programs that include shaders/funcs/frameData.glsl
+// (an std140 uniform block, so the members must keep this order and types);
+// upload it once per frame, before drawing, and those programs will not need
+// setMatrixes's view and projection nor setLight
+struct FrameData {
+	glm::mat4 view_matrix = glm::mat4(1.f), projection_matrix = glm::mat4(1.f);
+	glm::vec4 light_position = glm::vec4(0.f,0.f,1.f,0.f);
+	glm::vec3 light_color = glm::vec3(1.f); 
+	float ambient_strength = 0.f;
+	// the binding point of the uniform block in every Shader
+	static constexpr GLuint binding_point = 0;
+	void upload() const;
+};
+
+// the properties of all the materials, in a uniform buffer shared by all the
+// programs that include shaders/funcs/materials.glsl (an std140 array), so a
+// draw only needs the index of its material (see Shader::setMaterial)
+class MaterialTable {
+public:
+	// index of a material with the same properties (the texture does not 
+	// matter), adding it to the table if there is none yet
+	static int getIndex(const Material &mat);
+	static int size();
+	static constexpr int max_materials = 256; // as in materials.glsl
+	// the binding point of the uniform block in every Shader
+	static constexpr GLuint binding_point = 1;
 };
 
 GLuint loadShader(GLenum shader_type, const std::string &file_path);
@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <stb_image.h>
 #include "Texture.hpp"
+#include "TextureLoader.hpp"
+#include "CompressedImage.hpp"
 #include "Debug.hpp"
 
-Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t) {
+Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t, bool async) {
+	this->repeat_s = repeat_s; this->repeat_t = repeat_t;
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id); 
 	// set the texture wrapping parameters
@@ -13,19 +17,78 @@ Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	// load image, create texture and generate mipmaps
 	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+	// a compressed version with its mipmaps (see CompressedImage) is used if it
+	// is there (and up to date)
+	CompressedImage compressed; // its format stays 0 if there is none
+	if (GLAD_GL_EXT_texture_compression_s3tc) 
+		readCompressedImage(fname,compressed,async); // only the header if async
+	if (compressed.format) {
+		width = compressed.width; height = compressed.height;
+		channels = compressed.format==GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 3 : 4;
+		bits_per_pixel = CompressedImage::bitsPerPixel(compressed.format);
+	}
+	if (async) {
+		// only the header now; all the levels are allocated, but only the smallest
+		// one is used (and filled with a gray placeholder) until the loader
+		// uploads the real ones
+		if (not compressed.format)
+			cg_assert(stbi_info(fname.c_str(), &width, &height, &channels),"Could not load texture");
+		GLenum format = compressed.format ? compressed.format : GL_RGBA;
+		int levels = TextureLoader::levelsCount(width,height);
+		for(int i=0;i<levels;++i)
+			glTexImage2D(GL_TEXTURE_2D, i, format, std::max(1,width>>i), std::max(1,height>>i), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		if (format==GL_RGBA) {
+			const unsigned char gray[4] = {128,128,128,255};
+			glTexSubImage2D(GL_TEXTURE_2D, levels-1, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+		} else { // a BC3 block (alpha block, and then the color one), or only the color one for BC1
+			const unsigned char gray[16] = {255,255,0,0,0,0,0,0, 0x10,0x84,0x10,0x84,0,0,0,0};
+			int size = CompressedImage::blockSize(format);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, levels-1, 0, 0, 1, 1, format, size, gray+16-size);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels-1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels-1);
+		TextureLoader::request(id,fname,width,height,format);
+		return;
+	}
+	if (compressed.format) {
+		for(size_t i=0;i<compressed.levels.size();++i)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, compressed.format, std::max(1,width>>i), std::max(1,height>>i), 0, 
+								   compressed.levels[i].size(), compressed.levels[i].data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, compressed.levels.size()-1);
+		return;
+	}
 	// The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
 	unsigned char *data = stbi_load(fname.c_str(), &width, &height, &channels, 0);
 	cg_assert(data,"Could not load texture");
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, channels==3?GL_RGB:GL_RGBA, GL_UNSIGNED_BYTE, data);
 	glGenerateMipmap(GL_TEXTURE_2D);
 	stbi_image_free(data);
-	this->repeat_s = repeat_s; this->repeat_t = repeat_t;
+}
+
+Texture::Texture (const unsigned char *rgba, int width, int height, bool repeat_s, bool repeat_t) 
+	: width(width), height(height), channels(4), repeat_s(repeat_s), repeat_t(repeat_t), mipmaps(false)
+{
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_2D, id); 
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
 }
 
 Texture::~Texture ( ) {
+	freeResources();
+}
+
+void Texture::freeResources() {
+	if (id==0) return;
+	TextureLoader::cancel(id);
 	glDeleteTextures(1,&id);
 }
 
+bool Texture::isResident() const {
+	return id!=0 and not TextureLoader::isPending(id);
+}
+
 void Texture::bind (int number) const {
 	cg_assert(id!=0,"texture not initialized");
 	glActiveTexture(GL_TEXTURE0+number);
@@ -40,6 +103,7 @@ Texture::Texture (Texture &&t) {
 }
 
 Texture & Texture::operator=(Texture &&t) {
+	freeResources();
 	*this = static_cast<const Texture &>(t);
 	t = static_cast<const Texture &>(Texture{});
 	return *this;
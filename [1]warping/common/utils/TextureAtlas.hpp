@@ -0,0 +1,47 @@
+#ifndef TEXTUREATLAS_HPP
+#define TEXTUREATLAS_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Model.hpp"
+#include "Texture.hpp"
+
+// rectangle packer ("skyline", bottom-left): the top border of the area
+// already used is kept as a list of horizontal segments, and each rectangle
+// goes where its top ends lowest (then leftmost)
+class SkylinePacker {
+public:
+	SkylinePacker(int width, int height);
+	// false if it does not fit
+	bool insert(int width, int height, int &x, int &y);
+private:
+	struct Segment { int x, y, width; };
+	std::vector<Segment> skyline; // from left to right
+	int width, height;
+	// lowest y where a rectangle of width w fits starting at segment i (-1 if it does not)
+	int fitAt(size_t i, int w, int h) const;
+};
+
+// an image for the atlas, and how it was sampled (as in Texture)
+struct AtlasImage {
+	std::string fname; // empty if the part has no texture
+	bool repeat_s = true, repeat_t = true;
+};
+
+// merges the images of the parts of a model (images[i] for models[i]) in a
+// single texture, and changes the parts' tex_coords to point into it, so all
+// of them use the same texture (and parts with the same material and shader
+// could be drawn together); each image gets a border (padding texels) for
+// the filtering: a copy of the opposite side if it repeats, or transparent
+// pixels (the border color of GL_CLAMP_TO_BORDER) otherwise; the triangles
+// that cross the edges of the image (a repeat, or the end of a clamped image)
+// are split there, so their geometries may get new vertexes (the models need
+// fKeepGeometry, and their buffers are rebuilt, without lods)
+std::shared_ptr<const Texture> buildAtlas(std::vector<Model> &models, const std::vector<AtlasImage> &images, int padding = 8);
+
+// same, with the texture of each material (repeating, as Model::load loads it)
+std::shared_ptr<const Texture> buildAtlas(std::vector<Model> &models, int padding = 8);
+
+#endif
+
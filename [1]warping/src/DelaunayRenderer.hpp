@@ -11,6 +11,8 @@ public:
 	Shader &getShader();
 private:
 	Shader shader;
+	Shader::Attribute loc_pos;
+	Shader::Uniform<glm::vec3> loc_color;
 	GLuint VAO=0, VBO=0;
 	std::vector<glm::vec3> v_curve, v_poly;
 	glm::vec3 color_triangles = {0.5f, 0.5f, 0.5f};
@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include "Model.hpp"
+#include "ModelLoader.hpp"
 #include "Window.hpp"
 #include "Callbacks.hpp"
 #include "Debug.hpp"
@@ -15,6 +16,9 @@
 #include "BezierRenderer.hpp"
 #include "Delaunay.hpp"
 #include "DelaunayRenderer.hpp"
+#include "TextureLoader.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20220822
 using namespace std;
@@ -37,16 +41,23 @@ int selected_pt = -1;
 void mouseMoveCallback(GLFWwindow* window, double xpos, double ypos);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
+void clickAt(int button, int action, double xpos, double ypos);
+
+// entradas simuladas para el modo benchmark
+void benchmarkInput(GLFWwindow *window, int frame);
 
 // funciones para aplicar o deshacer la distorsin
 glm::vec3 warpPoint(const Delaunay &delaunay0, const Delaunay &delaunay1, glm::vec3 p);
-void applyWarp(const Delaunay &delaunay0, const Delaunay &del_new, 
-			   const Geometry &geometry, GeometryRenderer &renderer);
-void restoreGeometry(const Delaunay &delaunay0, const Delaunay &del_new, 
-			         const Geometry &geometry, GeometryRenderer &renderer);
+void applyWarp(const Delaunay &delaunay0, const Delaunay &del_new, const Geometry &geometry, 
+			   NormalsGenerator &normals, GeometryRenderer &renderer);
+void restoreGeometry(const Delaunay &delaunay0, const Delaunay &del_new, const Geometry &geometry, 
+			         NormalsGenerator &normals, GeometryRenderer &renderer);
 
 // programa principal
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" corre un benchmark sin ventana visible (ver Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Demo",true);
@@ -66,36 +77,55 @@ int main() {
 		   shader_wire("shaders/wireframe");
 	int loaded_model = -1;
 	std::vector<Model> models;
+	ModelLoader loader; // para cargar los modelos en segundo plano
+	std::vector<NormalsGenerator> normals; // para recalcular las normales de cada parte
 	DelaunayRenderer delaunay_renderer;
 	
 	// main loop
 	do {
 		
-		// cargar el modelo si es necesario
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(window,Benchmark::getFrame());
+		
+		// cargar el modelo si es necesario (se sigue mostrando el anterior 
+		// hasta que el nuevo est listo)
 		if (loaded_model!=current_model) {
-			models = Model::load(models_names[current_model],Model::fKeepGeometry|Model::fDynamic);
+			loader.request(models_names[current_model],Model::fKeepGeometry|Model::fDynamic);
 			loaded_model = current_model;
 		}
+		if (loader.update(models)) {
+			normals.clear();
+			for(const Model &part : models)
+				normals.emplace_back(part.geometry);
+		}
+		
+		// subir un poco ms de las texturas que an se estn cargando
+		TextureLoader::update();
 		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
+		// camara y luz, para todos los shaders
+		setFrameData(glm::vec4{-2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
+		
 		// dibujar el modelo
 		glPolygonMode(GL_FRONT_AND_BACK,wireframe?GL_LINE:GL_FILL);
-		for(Model &part : models) {
+		for(size_t i=0;i<models.size();++i) {
+			Model &part = models[i];
 			Shader &shader = wireframe ? shader_wire : shader_phong;
 			shader.use();
 			setMatrixes(shader);
-			shader.setLight(glm::vec4{-2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
 			// aplicar deformacion
 			auto func = apply_warp?applyWarp:restoreGeometry;
-			func(delaunay0,delaunay1,part.geometry,part.buffers);
+			func(delaunay0,delaunay1,part.geometry,normals[i],part.buffers);
 			shader.setBuffers(part.buffers);
-			shader.setMaterial(part.material);
+			shader.setMaterial(part.material_index);
+			PROFILE_GPU_SCOPE("modelo");
 			part.buffers.draw();
 		}
 		
 		// dibujar la triangulacion
 		if (show_delaunay||show_points) {
+			PROFILE_GPU_SCOPE("triangulacion");
 			glDisable(GL_DEPTH_TEST);
 			setMatrixes(delaunay_renderer.getShader());
 			delaunay_renderer.draw(current_delaunay().getPuntos(),
@@ -115,13 +145,14 @@ int main() {
 				delaunay1 = delaunay0;
 			if (ImGui::Button("Reset All (C)")) 
 				delaunay1 = delaunay0 = new_delaunay();
+			Profiler::drawImGui();
 		});
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
 }
 
 // distorsiona un vrtice de la geometra
@@ -153,26 +184,35 @@ glm::vec3 warpPoint(const Delaunay &delaunay0, const Delaunay &delaunay1, glm::v
 }
 
 // distorsiona toda la geometra
-void applyWarp(const Delaunay &delaunay0, const Delaunay &del_new,
-			   const Geometry &geometry, GeometryRenderer &renderer) 
+void applyWarp(const Delaunay &delaunay0, const Delaunay &del_new, const Geometry &geometry, 
+			   NormalsGenerator &normals, GeometryRenderer &renderer) 
 {
+	PROFILE_FUNCTION();
 	// obtener vertices deformados
 	Geometry new_geom;
 	new_geom.positions.reserve(geometry.positions.size());
-	for(glm::vec3 p : geometry.positions)
-		new_geom.positions.push_back( warpPoint(delaunay0,delaunay1,p) );
+	{
+		PROFILE_SCOPE("warpPoint");
+		for(glm::vec3 p : geometry.positions)
+			new_geom.positions.push_back( warpPoint(delaunay0,delaunay1,p) );
+	}
 	
-	// recalcular normales y enviar los nuevos datos a la gpu
+	// recalcular normales (con la adyacencia ya calculada para la geometra 
+	// original) y enviar los nuevos datos a la gpu
 	new_geom.triangles = geometry.triangles;
-	new_geom.generateNormals();
+	{
+		PROFILE_SCOPE("normals.generate");
+		normals.generate(new_geom);
+	}
 	renderer.updatePositions(new_geom.positions,false);
 	renderer.updateNormals(new_geom.normals,false);
 }
 
 // restablece los vertices originales
-void restoreGeometry(const Delaunay &delaunay0, const Delaunay &del_new,
-					 const Geometry &geometry, GeometryRenderer &renderer) 
+void restoreGeometry(const Delaunay &delaunay0, const Delaunay &del_new, const Geometry &geometry, 
+					 NormalsGenerator &normals, GeometryRenderer &renderer) 
 {
+	PROFILE_FUNCTION();
 	// enviar los datos originales a la gpu
 	renderer.updatePositions(geometry.positions,false);
 	renderer.updateNormals(geometry.normals,false);
@@ -240,10 +280,15 @@ void mouseMoveCallback(GLFWwindow* window, double xpos, double ypos) {
 // click derecho: eliminar vertice de la triangulacion
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 	if (ImGui::GetIO().WantCaptureMouse) return;
+	double xpos, ypos;
+	glfwGetCursorPos(window, &xpos, &ypos);
+	clickAt(button,action,xpos,ypos);
+}
+
+// lo mismo, para un click en (xpos,ypos) en coords de la ventana
+void clickAt(int button, int action, double xpos, double ypos) {
 	if (action == GLFW_PRESS) {
 		// pasar de coords de la ventana a coords del modelo
-		double xpos, ypos;
-		glfwGetCursorPos(window, &xpos, &ypos);
 		auto p = viewportToPlane(xpos,ypos);
 		// buscar vertice de la triangulacion cercano al click
 		selected_pt = closestPoint(p);
@@ -264,3 +309,20 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 	}
 }
 
+// cada 40 cuadros agrega un punto y lo arrastra (en espiral alrededor del 
+// centro), cada 200 muestra u oculta la triangulacin, y cada 400 reinicia 
+// los puntos y cambia de modelo
+void benchmarkInput(GLFWwindow *window, int frame) {
+	int k = frame/40, f = frame%40;
+	float ang = k*2.4f, size = float(std::min(win_width,win_height)),
+		  r = (.1f+.025f*(k*7%10))*size, d = .002f*size*f;
+	double x0 = win_width/2+r*std::cos(ang), y0 = win_height/2+r*std::sin(ang);
+	if (f==0) clickAt(GLFW_MOUSE_BUTTON_LEFT,GLFW_PRESS,x0,y0);
+	else if (f<30) mouseMoveCallback(window,x0-d*std::sin(ang),y0+d*std::cos(ang));
+	else if (f==30) clickAt(GLFW_MOUSE_BUTTON_LEFT,GLFW_RELEASE,x0,y0);
+	if (frame%200==100) keyboardCallback(window,'D',0,GLFW_PRESS,0);
+	if (frame%400==399) {
+		keyboardCallback(window,'C',0,GLFW_PRESS,0);
+		keyboardCallback(window,'O',0,GLFW_PRESS,0);
+	}
+}
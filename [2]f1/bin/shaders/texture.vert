@@ -4,11 +4,13 @@ in vec3 vertexPosition;
 in vec2 vertexTexCoords;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "funcs/frameData.glsl"
 out vec2 fragTexCoords;
 
+#include "funcs/decodeVertex.vert"
+
 void main() {
-	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
+	vec3 position = decodePosition(vertexPosition);
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position,1.f);
 	fragTexCoords = vertexTexCoords;
 }
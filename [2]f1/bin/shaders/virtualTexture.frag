@@ -0,0 +1,37 @@
+#version 330 core
+
+// textura virtual (ver VirtualTexture.hpp): la tabla de indireccion dice, para
+// cada tile de cada nivel, en que slot de la cache esta, o el del nivel mas
+// grueso que si esta (y cual es ese nivel)
+uniform sampler2D cacheTexture;
+uniform usampler2D indirectionTexture;
+uniform float tileSize; // texels de un tile, sin el borde
+uniform float tileBorder; // texels del borde de cada tile en la cache
+uniform float maxLevel; // el del tile que tiene toda la imagen
+uniform float maxAnisotropy;
+in vec2 fragTexCoords;
+out vec4 fragColor;
+
+void main() {
+	// texels (del nivel 0) por pixel, con las coordenadas sin repetir para que
+	// no haya saltos; el nivel es el que elegiria el filtrado anisotropico
+	vec2 image_size = vec2(textureSize(indirectionTexture,0))*tileSize;
+	vec2 dx = dFdx(fragTexCoords), dy = dFdy(fragTexCoords);
+	float lx = length(dx*image_size), ly = length(dy*image_size);
+	float lod = log2(max(max(min(lx,ly),max(lx,ly)/maxAnisotropy),1e-6));
+	int level = int(clamp(floor(lod),0.0,maxLevel));
+	
+	vec2 uv = fract(fragTexCoords); // la imagen se repite en la pista
+	ivec2 tiles = textureSize(indirectionTexture,level);
+	uvec4 entry = texelFetch(indirectionTexture,min(ivec2(uv*vec2(tiles)),tiles-1),level);
+	if (entry.a==0u) { fragColor = vec4(0.5,0.5,0.5,1.0); return; } // todavia no se cargo nada
+	
+	// la posicion dentro del tile que esta (que puede ser de un nivel mas grueso)
+	vec2 resident_tiles = vec2(textureSize(indirectionTexture,int(entry.b)));
+	vec2 in_tile = fract(uv*resident_tiles);
+	vec2 cache_size = vec2(textureSize(cacheTexture,0));
+	vec2 texel = vec2(entry.rg)*(tileSize+2.0*tileBorder)+tileBorder+in_tile*tileSize;
+	// las derivadas, en texels de la cache (del nivel de ese tile)
+	vec2 scale = resident_tiles*tileSize/cache_size;
+	fragColor = textureGrad(cacheTexture,texel/cache_size,dx*scale,dy*scale);
+}
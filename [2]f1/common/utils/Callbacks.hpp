@@ -26,5 +26,9 @@ void setCommonCallbacks(GLFWwindow* window);
 class Shader;
 void setMatrixes(Shader &shader);
 
+// uploads FrameData (see Shaders.hpp) with the view and projection matrixes
+// from getMatrixes and the given light, once per frame
+void setFrameData(const glm::vec4 &light_position, const glm::vec3 &light_color, float ambient_strength);
+
 #endif
 
@@ -0,0 +1,44 @@
+#ifndef COMPRESSEDIMAGE_HPP
+#define COMPRESSEDIMAGE_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// RGBA image with all its mipmap levels (level 0 first, down to 1x1), each
+// level half the size of the previous one (box filter)
+std::vector<std::vector<unsigned char>> buildMipmaps(const unsigned char *rgba, int width, int height);
+
+// block compressed image (BC1 if it is opaque, BC3 if it has alpha) with all
+// its mipmap levels; it is stored in a binary file next to the original image
+// (same name plus ".ctex"), so Texture can send it to the GPU as it is (4 or 8
+// times smaller than RGBA, and without generating the mipmaps at runtime)
+struct CompressedImage {
+	GLenum format = 0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	int width = 0, height = 0;
+	std::vector<std::vector<unsigned char>> levels; // level 0 first
+	static int blockSize(GLenum format) { return format==GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16; }
+	static int bitsPerPixel(GLenum format) { return format==GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 4 : 8; }
+};
+
+// encodes the image and the levels that buildMipmaps would give for it,
+// generating them one at a time while encoding; if stop returns true (it is
+// checked often) it gives up and returns an image without levels
+CompressedImage compressImage(const unsigned char *rgba, int width, int height, 
+							  const std::function<bool()> &stop = nullptr);
+
+// reads the file for image_path, returns false if it does not exist, if it is
+// older than the image, or if it is corrupt; with header_only, the levels are
+// not read (only format, width and height)
+bool readCompressedImage(const std::string &image_path, CompressedImage &image, bool header_only=false);
+
+bool writeCompressedImage(const std::string &image_path, const CompressedImage &image);
+
+// decodes the image, builds its mipmaps, and writes the compressed file; the
+// offline converter (base/common/tools) calls it for each image, and Texture
+// also does it in background the first time it loads an image asynchronously
+bool convertImage(const std::string &image_path);
+
+#endif
+
@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <tuple>
 #include <glm/ext.hpp>
 #include "Geometry.hpp"
 #include "Debug.hpp"
+#include "Misc.hpp"
 
 template<typename vector>
-static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool dynamic) {
+static void updateBuffer(GLenum type, GLuint &id, const vector &v, bool realloc, bool dynamic) {
 	if (id==0) {
 		cg_assert(realloc,"Texture coordinates not initialized");
 		glGenBuffers(1, &id);
@@ -15,30 +21,215 @@ static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool
 		glBufferSubData(type, 0, v.size()*sizeof(typename vector::value_type), v.data());
 }
 
-GeometryRenderer::GeometryRenderer(const Geometry &geo, bool dynamic) {
+// writes v at the given offset (in elements) of the buffer, replacing the 
+// buffer with a bigger one (keeping its previous contents) if it does not fit
+template<typename vector>
+static void appendBuffer(GLenum type, GLuint &id, const vector &v, size_t offset, bool dynamic) {
+	const size_t elem_size = sizeof(typename vector::value_type);
+	size_t needed = (offset+v.size())*elem_size;
+	GLint64 capacity = 0;
+	if (id) {
+		glBindBuffer(GL_COPY_READ_BUFFER,id);
+		glGetBufferParameteri64v(GL_COPY_READ_BUFFER,GL_BUFFER_SIZE,&capacity);
+	}
+	if (needed>static_cast<size_t>(capacity)) {
+		GLuint new_id;
+		glGenBuffers(1,&new_id);
+		glBindBuffer(GL_COPY_WRITE_BUFFER,new_id);
+		glBufferData(GL_COPY_WRITE_BUFFER, std::max(needed,2*static_cast<size_t>(capacity)), nullptr, dynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
+		if (id) {
+			glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,0,0,offset*elem_size);
+			glDeleteBuffers(1,&id);
+		}
+		id = new_id;
+	}
+	glBindBuffer(type, id);
+	glBufferSubData(type, offset*elem_size, v.size()*elem_size, v.data());
+}
+
+// writes the attribute v into the interleaved buffer id (keeping the others)
+template<typename vector>
+static void updateInterleaved(GLuint id, const vector &v, GLsizei stride, size_t offset) {
+	const size_t elem_size = sizeof(typename vector::value_type);
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	char *p = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, v.size()*stride, GL_MAP_WRITE_BIT));
+	cg_assert(p,"Could not map the vertex buffer");
+	for(size_t i=0;i<v.size();++i)
+		std::memcpy(p+i*stride+offset,&v[i],elem_size);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+// copies the attribute v into the interleaved data
+template<typename vector>
+static void interleave(std::vector<char> &data, const vector &v, GLsizei stride, size_t offset) {
+	const size_t elem_size = sizeof(typename vector::value_type);
+	for(size_t i=0;i<v.size();++i)
+		std::memcpy(&data[i*stride+offset],&v[i],elem_size);
+}
+
+static bool fitsInShort(const std::vector<int> &v) {
+	return std::all_of(v.begin(),v.end(),[](int i){ return i>=0 and i<=0xFFFF; });
+}
+
+static std::vector<GLushort> toShort(const std::vector<int> &v) {
+	return std::vector<GLushort>(v.begin(),v.end());
+}
+
+// --- quantized attributes ---
+
+namespace {
+struct QuantizedPosition { GLshort x, y, z, pad; }; // padded to 8 bytes, so the next attribute is aligned
+struct QuantizedNormal { GLshort x, y; };
+struct QuantizedTexCoords { GLhalf s, t; };
+}
+
+static GLshort toSnorm16(float f) {
+	return static_cast<GLshort>(std::round(glm::clamp(f,-1.f,1.f)*32767.f));
+}
+
+static GLhalf toHalf(float f) {
+	uint32_t x; std::memcpy(&x,&f,sizeof(x));
+	uint32_t sign = (x>>16)&0x8000, mant = x&0x7FFFFF, fexp = (x>>23)&0xFF;
+	int exp = int(fexp)-127+15;
+	if (fexp==0xFF) return sign|0x7C00|(mant?0x200:0); // inf or nan
+	if (exp>=31) return sign|0x7C00; // too big, inf
+	if (exp<=0) { // denormal (or zero)
+		if (exp<-10) return sign;
+		mant |= 0x800000;
+		uint32_t shift = 14-exp, h = mant>>shift;
+		if ((mant>>(shift-1))&1) ++h;
+		return sign|h;
+	}
+	uint32_t h = sign|(exp<<10)|(mant>>13);
+	if (mant&0x1000) ++h; // rounding, a carry goes to the exponent as it should
+	return h;
+}
+
+// scale and offset that map the bounding box of v to [-1;+1] in each axis
+static void getQuantizationRange(const std::vector<glm::vec3> &v, glm::vec3 &scale, glm::vec3 &offset) {
+	glm::vec3 pmin, pmax;
+	std::tie(pmin,pmax) = getBoundingBox(v);
+	offset = (pmin+pmax)*.5f;
+	scale = (pmax-pmin)*.5f;
+	for(int i=0;i<3;++i) 
+		if (scale[i]==0.f) scale[i] = 1.f; // flat in this axis
+}
+
+static std::vector<QuantizedPosition> quantizePositions(const std::vector<glm::vec3> &v, const glm::vec3 &scale, const glm::vec3 &offset) {
+	std::vector<QuantizedPosition> q(v.size());
+	for(size_t i=0;i<v.size();++i) {
+		glm::vec3 p = (v[i]-offset)/scale;
+		q[i] = { toSnorm16(p.x), toSnorm16(p.y), toSnorm16(p.z), 0 };
+	}
+	return q;
+}
+
+// octahedral encoding: the normal is projected on the octahedron 
+// |x|+|y|+|z|=1, and its lower half (z<0) is folded over the upper one
+static std::vector<QuantizedNormal> quantizeNormals(const std::vector<glm::vec3> &v) {
+	std::vector<QuantizedNormal> q(v.size());
+	for(size_t i=0;i<v.size();++i) {
+		const glm::vec3 &n = v[i];
+		float l1 = std::abs(n.x)+std::abs(n.y)+std::abs(n.z);
+		if (l1==0.f) { q[i] = {0,0}; continue; }
+		float x = n.x/l1, y = n.y/l1;
+		if (n.z<0.f) {
+			float fx = (1.f-std::abs(y))*(x>=0.f?1.f:-1.f);
+			float fy = (1.f-std::abs(x))*(y>=0.f?1.f:-1.f);
+			x = fx; y = fy;
+		}
+		q[i] = { toSnorm16(x), toSnorm16(y) };
+	}
+	return q;
+}
+
+static std::vector<QuantizedTexCoords> quantizeTexCoords(const std::vector<glm::vec2> &v) {
+	std::vector<QuantizedTexCoords> q(v.size());
+	for(size_t i=0;i<v.size();++i)
+		q[i] = { toHalf(v[i].x), toHalf(v[i].y) };
+	return q;
+}
+
+GeometryRenderer::GeometryRenderer(const Geometry &geo, bool dynamic, bool interleaved, bool quantize) {
 	
 	cg_assert(geo.positions.size(),"Empty Geometry");
+	if (not geo.normals.empty())
+		cg_assert(geo.normals.size()==geo.positions.size(),"Wrong normals count");
+	if (not geo.tex_coords.empty())
+		cg_assert(geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
 	
 	glGenVertexArrays(1,&VAO);
 	glBindVertexArray(VAO);
 	
-	updateBuffer(GL_ARRAY_BUFFER,VBO_pos,geo.positions,true,dynamic);
-	
-	if (not geo.normals.empty()) {
-		cg_assert(geo.normals.size()==geo.positions.size(),"Wrong normals count");
-		updateBuffer(GL_ARRAY_BUFFER,VBO_norms,geo.normals,true,dynamic);  
-	}
-	if (not geo.tex_coords.empty()) {
-		cg_assert(geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
-		updateBuffer(GL_ARRAY_BUFFER,VBO_tcs,geo.tex_coords,true, dynamic);  
+	if (interleaved or quantize) {
+		quantized = quantize;
+		size_t pos_size = quantized ? sizeof(QuantizedPosition) : sizeof(glm::vec3);
+		size_t norm_size = quantized ? sizeof(QuantizedNormal) : sizeof(glm::vec3);
+		size_t tc_size = quantized ? sizeof(QuantizedTexCoords) : sizeof(glm::vec2);
+		offset_norms = pos_size;
+		offset_tcs = offset_norms + (geo.normals.empty() ? 0 : norm_size);
+		stride = offset_tcs + (geo.tex_coords.empty() ? 0 : tc_size);
+		std::vector<char> data(geo.positions.size()*stride);
+		if (quantized) {
+			getQuantizationRange(geo.positions,position_scale,position_offset);
+			interleave(data,quantizePositions(geo.positions,position_scale,position_offset),stride,0);
+			interleave(data,quantizeNormals(geo.normals),stride,offset_norms);
+			interleave(data,quantizeTexCoords(geo.tex_coords),stride,offset_tcs);
+		} else {
+			interleave(data,geo.positions,stride,0);
+			interleave(data,geo.normals,stride,offset_norms);
+			interleave(data,geo.tex_coords,stride,offset_tcs);
+		}
+		updateBuffer(GL_ARRAY_BUFFER,VBO_pos,data,true,dynamic);
+		if (not geo.normals.empty()) VBO_norms = VBO_pos; else offset_norms = 0;
+		if (not geo.tex_coords.empty()) VBO_tcs = VBO_pos; else offset_tcs = 0;
+	} else {
+		updateBuffer(GL_ARRAY_BUFFER,VBO_pos,geo.positions,true,dynamic);
+		if (not geo.normals.empty())
+			updateBuffer(GL_ARRAY_BUFFER,VBO_norms,geo.normals,true,dynamic);  
+		if (not geo.tex_coords.empty())
+			updateBuffer(GL_ARRAY_BUFFER,VBO_tcs,geo.tex_coords,true, dynamic);  
 	}
+	
 	if (not geo.triangles.empty()) {
-		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,geo.triangles,true,dynamic);
+		updateElements(geo.triangles,true,dynamic);
 		count = geo.triangles.size();
 	} else 
 		count = geo.positions.size();
+	vertex_count = geo.positions.size();
 	
-	glBindVertexArray(0);
+	setupVertexArray();
+}
+
+// the attributes (with their formats) in their fixed locations, and the
+// elements buffer, in the VAO
+void GeometryRenderer::setupVertexArray() {
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER,VBO_pos);
+	if (quantized)
+		glVertexAttribPointer(aPosition, 3, GL_SHORT, GL_TRUE, stride, 0);
+	else
+		glVertexAttribPointer(aPosition, 3, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(aPosition);
+	if (VBO_norms) {
+		glBindBuffer(GL_ARRAY_BUFFER,VBO_norms);
+		if (quantizedNormals())
+			glVertexAttribPointer(aNormal, 2, GL_SHORT, GL_TRUE, normalsStride(), 
+								  reinterpret_cast<const void*>(offset_norms));
+		else
+			glVertexAttribPointer(aNormal, 3, GL_FLOAT, GL_FALSE, normalsStride(), 
+								  reinterpret_cast<const void*>(offset_norms));
+		glEnableVertexAttribArray(aNormal);
+	} else
+		glDisableVertexAttribArray(aNormal);
+	if (VBO_tcs) {
+		glBindBuffer(GL_ARRAY_BUFFER,VBO_tcs);
+		glVertexAttribPointer(aTexCoords, 2, quantizedTexCoords()?GL_HALF_FLOAT:GL_FLOAT, GL_FALSE, 
+							  texCoordsStride(), reinterpret_cast<const void*>(offset_tcs));
+		glEnableVertexAttribArray(aTexCoords);
+	} else
+		glDisableVertexAttribArray(aTexCoords);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO);
 }
 
 GeometryRenderer::GeometryRenderer(GeometryRenderer &&geo) {
@@ -55,16 +246,15 @@ GeometryRenderer &GeometryRenderer::operator=(GeometryRenderer &&geo) {
 
 void GeometryRenderer::draw() const {
 	glBindVertexArray(VAO);
-	if (EBO) glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
+	if (EBO) glDrawElements(GL_TRIANGLES, count, index_type, 0);
 	else glDrawArrays(GL_TRIANGLES, 0,count);
-	glBindVertexArray(0);
 }
 
 void GeometryRenderer::freeResources() {
 	if (VAO==0) return;
 	if (VBO_pos) glDeleteBuffers(1,&VBO_pos);
-	if (VBO_norms) glDeleteBuffers(1,&VBO_norms);
-	if (VBO_tcs) glDeleteBuffers(1,&VBO_tcs);
+	if (VBO_norms and VBO_norms!=VBO_pos) glDeleteBuffers(1,&VBO_norms);
+	if (VBO_tcs and VBO_tcs!=VBO_pos) glDeleteBuffers(1,&VBO_tcs);
 	if (EBO) glDeleteBuffers(1,&EBO);
 	glDeleteVertexArrays(1,&VAO);
 }
@@ -72,43 +262,166 @@ GeometryRenderer::~GeometryRenderer() {
 	freeResources();
 }
 
+size_t GeometryRenderer::memorySize() const {
+	size_t size = 0;
+	auto addBuffer = [&](GLuint id) {
+		if (id==0) return;
+		GLint64 buffer_size = 0;
+		glBindBuffer(GL_COPY_READ_BUFFER,id);
+		glGetBufferParameteri64v(GL_COPY_READ_BUFFER,GL_BUFFER_SIZE,&buffer_size);
+		size += static_cast<size_t>(buffer_size);
+	};
+	addBuffer(VBO_pos);
+	if (VBO_norms!=VBO_pos) addBuffer(VBO_norms);
+	if (VBO_tcs!=VBO_pos) addBuffer(VBO_tcs);
+	addBuffer(EBO);
+	return size;
+}
+
+// in the interleaved VBO an attribute can not be reallocated, but one that is
+// not there yet can be added in its own VBO
+
 void GeometryRenderer::updateTexCoords (const std::vector<glm::vec2> &vtc, bool realloc, bool dynamic) {
-	updateBuffer(GL_ARRAY_BUFFER, VBO_tcs,vtc,realloc,dynamic);
+	if (stride and VBO_tcs==VBO_pos) {
+		cg_assert(not realloc,"Can not reallocate an interleaved attribute");
+		if (quantized) updateInterleaved(VBO_tcs,quantizeTexCoords(vtc),stride,offset_tcs);
+		else updateInterleaved(VBO_tcs,vtc,stride,offset_tcs);
+	} else
+		updateBuffer(GL_ARRAY_BUFFER, VBO_tcs,vtc,realloc,dynamic);
+	if (realloc) setupVertexArray();
 }
 
 void GeometryRenderer::updatePositions (const std::vector<glm::vec3> &vp, bool realloc, bool dynamic) {
-	updateBuffer(GL_ARRAY_BUFFER, VBO_pos,vp,realloc,dynamic);
+	if (stride) {
+		cg_assert(not realloc,"Can not reallocate an interleaved attribute");
+		if (quantized) { // the range follows the new positions (see Shader::setBuffers)
+			getQuantizationRange(vp,position_scale,position_offset);
+			updateInterleaved(VBO_pos,quantizePositions(vp,position_scale,position_offset),stride,0);
+		} else
+			updateInterleaved(VBO_pos,vp,stride,0);
+	} else
+		updateBuffer(GL_ARRAY_BUFFER, VBO_pos,vp,realloc,dynamic);
+	if (realloc) setupVertexArray();
 }
 
 void GeometryRenderer::updateNormals (const std::vector<glm::vec3> &vn, bool realloc, bool dynamic) {
-	updateBuffer(GL_ARRAY_BUFFER, VBO_norms,vn,realloc,dynamic);
+	if (stride and VBO_norms==VBO_pos) {
+		cg_assert(not realloc,"Can not reallocate an interleaved attribute");
+		if (quantized) updateInterleaved(VBO_norms,quantizeNormals(vn),stride,offset_norms);
+		else updateInterleaved(VBO_norms,vn,stride,offset_norms);
+	} else
+		updateBuffer(GL_ARRAY_BUFFER, VBO_norms,vn,realloc,dynamic);
+	if (realloc) setupVertexArray();
 }
 
 void GeometryRenderer::updateElements(const std::vector<int> &ve, bool realloc, bool dynamic) {
-	updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,ve,realloc,dynamic);
+	glBindVertexArray(VAO); // the elements buffer binding is part of the VAO
+	if (realloc) index_type = fitsInShort(ve) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (index_type==GL_UNSIGNED_SHORT) {
+		cg_assert(fitsInShort(ve),"Indexes do not fit in the 16 bits element buffer");
+		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,toShort(ve),realloc,dynamic);
+	} else
+		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,ve,realloc,dynamic);
+}
+
+void GeometryRenderer::append(const Geometry &geo, bool dynamic) {
+	if (geo.positions.empty()) return;
+	cg_assert(not geo.triangles.empty(),"Only indexed geometry can be appended");
+	cg_assert(stride==0 and index_type==GL_UNSIGNED_INT,"Can not append to interleaved or 16 bits buffers");
+	cg_assert(vertex_count==0 or (VBO_norms!=0)==(not geo.normals.empty()),"Wrong normals count");
+	cg_assert(vertex_count==0 or (VBO_tcs!=0)==(not geo.tex_coords.empty()),"Wrong texture coordinates count");
+	
+	if (VAO==0) glGenVertexArrays(1,&VAO);
+	glBindVertexArray(VAO);
+	
+	appendBuffer(GL_ARRAY_BUFFER,VBO_pos,geo.positions,vertex_count,dynamic);
+	if (not geo.normals.empty()) {
+		cg_assert(geo.normals.size()==geo.positions.size(),"Wrong normals count");
+		appendBuffer(GL_ARRAY_BUFFER,VBO_norms,geo.normals,vertex_count,dynamic);
+	}
+	if (not geo.tex_coords.empty()) {
+		cg_assert(geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
+		appendBuffer(GL_ARRAY_BUFFER,VBO_tcs,geo.tex_coords,vertex_count,dynamic);
+	}
+	std::vector<int> triangles(geo.triangles);
+	for(int &i : triangles) i += vertex_count;
+	appendBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,triangles,count,dynamic);
+	
+	count += triangles.size();
+	vertex_count += geo.positions.size();
+	setupVertexArray(); // the buffers may have been replaced
 }
 
-void Geometry::generateNormals ( ) {
-	normals.clear();
+// triangles per thread for generating normals (less is not worth the threads)
+static const size_t normals_min_range = 16*1024;
+
+void Geometry::generateNormals (bool angle_weighted) {
+	if (not triangles.empty()) {
+		NormalsGenerator(*this).generate(*this,angle_weighted);
+		return;
+	}
 	normals.resize(positions.size());
-	if (triangles.empty()) {
-		for(size_t i=0;i<positions.size();i+=3)
+	parallelFor(positions.size()/3,normals_min_range,[&](size_t begin, size_t end) {
+		for(size_t i=3*begin;i<3*end;i+=3)
 			normals[i] = normals[i+1] = normals[i+2] = 
 				glm::normalize(
 					glm::cross(
 						(positions[i+2]-positions[i+1]),
 						(positions[i+0]-positions[i+1]) ) );
-	} else {
-		for(size_t i=0;i<triangles.size();i+=3) {
-			auto n = glm::cross( (positions[triangles[i+2]]-positions[triangles[i+1]]),
-								 (positions[triangles[i+0]]-positions[triangles[i+1]]) );
-			normals[triangles[i+0]] += n;
-			normals[triangles[i+1]] += n;
-			normals[triangles[i+2]] += n;
+	});
+}
+
+NormalsGenerator::NormalsGenerator(const Geometry &geo) : offsets(geo.positions.size()+1,0) {
+	const std::vector<int> &tris = geo.triangles;
+	for(int v : tris) ++offsets[v+1];
+	for(size_t v=0;v+1<offsets.size();++v) offsets[v+1] += offsets[v];
+	corners.resize(tris.size());
+	std::vector<int> next(offsets.begin(),offsets.end()-1);
+	for(size_t c=0;c<tris.size();++c)
+		corners[next[tris[c]]++] = c;
+}
+
+void NormalsGenerator::generate(Geometry &geo, bool angle_weighted) {
+	const std::vector<glm::vec3> &pos = geo.positions;
+	const std::vector<int> &tris = geo.triangles;
+	cg_assert(offsets.size()==pos.size()+1 and corners.size()==tris.size(),"NormalsGenerator built for another geometry");
+	size_t ntris = tris.size()/3;
+	
+	// triangle normals (not normalized, so their lengths are proportional to
+	// the areas) in separated arrays, and the angle of each corner if needed
+	face_x.resize(ntris); face_y.resize(ntris); face_z.resize(ntris);
+	if (angle_weighted) corner_weights.resize(tris.size());
+	parallelFor(ntris,normals_min_range,[&](size_t begin, size_t end) {
+		for(size_t t=begin;t<end;++t) {
+			const glm::vec3 &p0 = pos[tris[3*t]], &p1 = pos[tris[3*t+1]], &p2 = pos[tris[3*t+2]];
+			glm::vec3 n = glm::cross(p2-p1,p0-p1);
+			face_x[t] = n.x; face_y[t] = n.y; face_z[t] = n.z;
+			if (not angle_weighted) continue;
+			float len = glm::length(n);
+			const glm::vec3 *p[3] = { &p0, &p1, &p2 };
+			for(int k=0;k<3;++k) {
+				glm::vec3 e1 = *p[(k+1)%3]-*p[k], e2 = *p[(k+2)%3]-*p[k];
+				float l = glm::length(e1)*glm::length(e2);
+				float angle = l>0.f ? std::acos(glm::clamp(glm::dot(e1,e2)/l,-1.f,1.f)) : 0.f;
+				corner_weights[3*t+k] = len>0.f ? angle/len : 0.f; // normalizes n too
+			}
+		}
+	});
+	
+	// each vertex gathers the normals of its own triangles, so there are no
+	// races between threads (and the sums are done in the same order as in
+	// a sequential scatter over the triangles)
+	geo.normals.resize(pos.size());
+	parallelFor(pos.size(),normals_min_range,[&](size_t begin, size_t end) {
+		for(size_t v=begin;v<end;++v) {
+			glm::vec3 n(0.f);
+			for(int i=offsets[v];i<offsets[v+1];++i) {
+				int c = corners[i], t = c/3;
+				glm::vec3 fn(face_x[t],face_y[t],face_z[t]);
+				n += angle_weighted ? fn*corner_weights[c] : fn;
+			}
+			geo.normals[v] = glm::dot(n,n)!=0 ? glm::normalize(n) : n;
 		}
-		for(auto &n : normals) 
-			if (glm::dot(n,n)!=0) 
-				n = glm::normalize(n);
-	}	
+	});
 }
 
@@ -11,34 +11,86 @@ struct Geometry {
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec2> tex_coords;
 	std::vector<int> triangles;
-	void generateNormals();
+	// area weighted (the default) or angle weighted average of the normals of
+	// the triangles around each vertex (flat normals if it is not indexed)
+	void generateNormals(bool angle_weighted=false);
 	
 };
 
+// vertex->triangles adjacency of an indexed Geometry, to regenerate its normals
+// many times (for instance, after moving its vertexes) without rebuilding it;
+// it does not depend on the positions, only on the triangles
+class NormalsGenerator {
+public:
+	NormalsGenerator() = default;
+	NormalsGenerator(const Geometry &geo);
+	// same as geo.generateNormals (geo must have the same triangles)
+	void generate(Geometry &geo, bool angle_weighted=false);
+private:
+	std::vector<int> offsets, corners; // CSR: corners (3*triangle+k) around each vertex
+	std::vector<float> face_x, face_y, face_z, corner_weights; // per-call buffers
+};
+
 class GeometryRenderer {
 public:
 	GeometryRenderer() = default;
-	GeometryRenderer(const Geometry &geo, bool dynamic=false);
+	// interleaved: a single VBO with all the attributes of each vertex together
+	// (otherwise, a VBO for each attribute); quantized: interleaved too, but
+	// with positions in snorm16 (relative to the bounding box), octahedral
+	// normals in 2 snorm16 and half float texture coordinates
+	GeometryRenderer(const Geometry &geo, bool dynamic=false, bool interleaved=false, bool quantized=false);
 	GeometryRenderer(GeometryRenderer &&geo);
 	GeometryRenderer &operator=(GeometryRenderer &&geo);
+	// the VAO is configured once (when the buffers are created), with each
+	// attribute in a fixed location that every Shader uses (glBindAttribLocation
+	// before linking), so drawing only binds it; the VAO stays bound afterwards
+	enum Attributes { aPosition=0, aNormal=1, aTexCoords=2 };
 	void draw() const;
 	GLuint vertexArray() const { return VAO; }
 	GLuint positionsVBO() const { return VBO_pos; }
 	GLuint normalsVBO() const { return VBO_norms; }
 	GLuint texCoordsVBO() const { return VBO_tcs; }
+	// layout of each attribute in its VBO (stride 0 means tightly packed)
+	GLsizei positionsStride() const { return stride; }
+	GLsizei normalsStride() const { return VBO_norms==VBO_pos ? stride : 0; }
+	GLsizei texCoordsStride() const { return VBO_tcs==VBO_pos ? stride : 0; }
+	size_t normalsOffset() const { return offset_norms; }
+	size_t texCoordsOffset() const { return offset_tcs; }
+	// formats of the quantized attributes (see shaders/funcs/decodeVertex.vert),
+	// decoded position = quantized position * positionScale + positionOffset
+	bool quantizedPositions() const { return quantized; }
+	bool quantizedNormals() const { return quantized and VBO_norms==VBO_pos; }
+	bool quantizedTexCoords() const { return quantized and VBO_tcs==VBO_pos; }
+	const glm::vec3 &positionScale() const { return position_scale; }
+	const glm::vec3 &positionOffset() const { return position_offset; }
+	// GL_UNSIGNED_SHORT if all the indexes fit in 16 bits, GL_UNSIGNED_INT otherwise
+	GLenum indexType() const { return index_type; }
+	// bytes used by all its buffers in the GPU
+	size_t memorySize() const;
 	
 	void updateTexCoords(const std::vector<glm::vec2> &vtc, bool realloc=false, bool dynamic=false);
 	void updatePositions(const std::vector<glm::vec3> &vp, bool realloc=false, bool dynamic=false);
 	void updateNormals(const std::vector<glm::vec3> &vn, bool realloc=false, bool dynamic=false);
 	void updateElements(const std::vector<int> &ve, bool realloc=false, bool dynamic=false);
 	
+	// adds more triangles (and their vertexes) to the buffers, growing them as
+	// needed; for meshes uploaded in parts (triangles in geo are relative to
+	// geo's own vertexes)
+	void append(const Geometry &geo, bool dynamic=false);
+	
 	~GeometryRenderer();
 private:
 	GeometryRenderer(const GeometryRenderer &) = delete;
 	GeometryRenderer &operator=(const GeometryRenderer &) = default;
 	void freeResources();
+	void setupVertexArray();
 	GLuint VAO=0, VBO_pos=0, VBO_tcs=0, VBO_norms=0, EBO=0;
-	int count = 0;
+	int count = 0, vertex_count = 0;
+	GLenum index_type = GL_UNSIGNED_INT;
+	GLsizei stride = 0; // of the interleaved VBO (0 if not interleaved)
+	size_t offset_norms = 0, offset_tcs = 0;
+	bool quantized = false;
+	glm::vec3 position_scale = glm::vec3(1.f), position_offset = glm::vec3(0.f);
 };
 
 #endif
@@ -0,0 +1,31 @@
+#ifndef GEOMETRYOPTIMIZER_HPP
+#define GEOMETRYOPTIMIZER_HPP
+
+#include "Geometry.hpp"
+
+// efficiency of the post-transform vertex cache for the triangles of a
+// Geometry, simulating a FIFO cache of cache_size vertexes
+struct VertexCacheStats {
+	float acmr = 0; // average cache miss ratio (transformed vertexes per triangle)
+	float atvr = 0; // average transformed vertex ratio (transformed vertexes per vertex)
+};
+VertexCacheStats analyzeVertexCache(const Geometry &geo, int cache_size=16);
+
+// reorders the triangles to reuse the vertexes in the post-transform cache
+// (Tom Forsyth's "Linear-Speed Vertex Cache Optimisation")
+void optimizeVertexCache(Geometry &geo);
+
+// reorders clusters of triangles (keeping the cache friendly order inside each
+// one) so the ones facing outwards are drawn first, to reduce overdraw from any
+// point of view; it allows a cache efficiency loss up to threshold
+void optimizeOverdraw(Geometry &geo, float threshold=1.05f);
+
+// renumbers the vertexes in the order they are first used by the triangles
+// (and moves their attributes accordingly) so they are fetched sequentially
+void optimizeVertexFetch(Geometry &geo);
+
+// all of the above
+void optimizeGeometry(Geometry &geo);
+
+#endif
+
@@ -1,38 +1,80 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 #include <vector>
+#include <string>
+#include <functional>
+#include <memory>
+#include <glm/mat4x4.hpp>
 #include "Geometry.hpp"
 #include "Material.hpp"
 #include "Texture.hpp"
+#include "GeometryOptimizer.hpp"
 
 // auxiliar struct for loading all model-related data
 struct Model {
 	Geometry geometry;
 	GeometryRenderer buffers;
 	Material material;
-	Texture texture;
+	// index of material in the MaterialTable (get it again if material changes)
+	int material_index = -1;
+	// the image of material.texture (null if it has none), shared with the
+	// other models that use the same file (see AssetCache)
+	std::shared_ptr<const Texture> texture;
+	
+	// simplified versions of buffers (see fLods), from finer to coarser; error
+	// is the approx. distance (in model units) to the original surface
+	struct Lod { GeometryRenderer buffers; float error; };
+	std::vector<Lod> lods;
+	glm::vec3 lod_center; float lod_radius = 0.f; // bounding sphere of the model
+	
+	// efficiency of the post-transform vertex cache before and after the
+	// reordering of fOptimize (zeros without it, or with fStream)
+	VertexCacheStats cache_before, cache_after;
+	// the coarsest buffers whose error, projected on the screen (of the given 
+	// height) at the nearest point of the bounding sphere, is below max_pixels
+	const GeometryRenderer &selectLod(const glm::mat4 &model_view, const glm::mat4 &projection,
+									  int viewport_height, float max_pixels=1.f) const;
 	
 	Model() = default;
-	Model(const Geometry &g, const Material &m) 
-		: buffers(g), material(m), 
-		  texture(m.texture.empty() ? Texture() : Texture(m.texture))
-	{
-		
-	}
-	Model(Geometry &&g, const Material &m, bool keep_geometry=false) 
-		: buffers(g), material(m), 
-		  texture(m.texture.empty() ? Texture() : Texture(m.texture))
-	{
-		if (keep_geometry) geometry = std::move(g);
-	}
+	Model(const Geometry &g, const Material &m);
+	Model(Geometry &&g, const Material &m, bool keep_geometry=false, 
+		  bool dynamic=false, bool interleaved=false, bool quantized=false);
+	Model(GeometryRenderer &&b, const Material &m);
 	
 	enum Flags { fNone=0, fDontFit=1, fKeepGeometry=2, 
-				 fRegenerateNormals=4, fDynamic=8 };
+				 fRegenerateNormals=4, fDynamic=8, 
+				 fStream=32, fOptimize=64, fInterleaved=128, fQuantized=256, 
+				 fLods=512 };
 	static std::vector<Model> load(const std::string &name, int flags = 0);
+	
+	// a part of a model before it is sent to the GPU: prepare does all the work
+	// of load that does not need OpenGL (so it can run in another thread, see
+	// ModelLoader), calling callback for each part, and the constructor from a
+	// PreparedPart only uploads it (fStream can not be used this way)
+	struct PreparedPart {
+		std::string name;
+		Geometry geometry;
+		Material material;
+		std::vector<Geometry> lods;
+		std::vector<float> lod_errors;
+		glm::vec3 lod_center; float lod_radius = 0.f;
+		VertexCacheStats cache_before, cache_after;
+		int flags = 0;
+	};
+	static void prepare(const std::string &name, int flags, const std::function<void(PreparedPart&&)> &callback);
+	Model(PreparedPart &&part);
+	// max RAM (in bytes, approx.) for the faces being converted when loading
+	// with fStream (the vertex attributes of the whole file are kept anyway)
+	static size_t stream_budget;
+	// max number of simplified versions generated with fLods (each one with
+	// half the triangles of the previous one)
+	static int lod_count;
 	static Model loadSingle(const std::string &name, int flags = 0);
 };
 
 void centerAndResize(std::vector<glm::vec3> &v);
+// same, but using a given bounding box (for parts of a bigger model)
+void centerAndResize(std::vector<glm::vec3> &v, glm::vec3 pmin, glm::vec3 pmax);
 
 #endif
 
@@ -0,0 +1,91 @@
+#include <limits>
+#include "ModelLoader.hpp"
+#include "Benchmark.hpp"
+#include "Debug.hpp"
+
+// bytes that a part will take in the GPU (approx.)
+static size_t gpuSize(const Geometry &g) {
+	return g.positions.size()*sizeof(glm::vec3) + g.normals.size()*sizeof(glm::vec3)
+		 + g.tex_coords.size()*sizeof(glm::vec2) + g.triangles.size()*sizeof(int);
+}
+
+static size_t gpuSize(const Model::PreparedPart &part) {
+	size_t size = gpuSize(part.geometry);
+	for(const Geometry &lod : part.lods) size += gpuSize(lod);
+	return size;
+}
+
+void ModelLoader::request(const std::string &name, int flags) {
+	cg_assert(!(flags&Model::fStream),"fStream models can not be loaded asynchronously");
+	if (job) discarded.push_back(std::move(job));
+	uploaded.clear();
+	job = std::make_shared<Job>();
+	std::shared_ptr<Job> my_job = job; // the worker keeps it alive even if discarded
+	job->worker = std::thread([my_job,name,flags]() {
+		try {
+			Model::prepare(name,flags,[&](Model::PreparedPart &&part) {
+				std::lock_guard<std::mutex> lock(my_job->mutex);
+				my_job->ready.push_back(std::move(part));
+			});
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(my_job->mutex);
+			my_job->error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(my_job->mutex);
+		my_job->done = true;
+	});
+}
+
+bool ModelLoader::update(std::vector<Model> &models, size_t budget) {
+	// in a benchmark the result must not depend on how long the worker takes,
+	// so the model is completed in the same frame it was requested
+	bool wait = Benchmark::isActive();
+	joinDiscarded(wait);
+	if (not job) return false;
+	if (wait) {
+		job->worker.join();
+		budget = std::numeric_limits<size_t>::max();
+	}
+	for(size_t bytes=0;;) {
+		std::unique_lock<std::mutex> lock(job->mutex);
+		if (job->ready.empty()) {
+			if (not job->done) return false;
+			lock.unlock();
+			if (job->worker.joinable()) job->worker.join();
+			std::exception_ptr error = job->error;
+			job.reset();
+			if (error) { uploaded.clear(); std::rethrow_exception(error); }
+			models = std::move(uploaded);
+			uploaded.clear();
+			return true;
+		}
+		size_t size = gpuSize(job->ready.front());
+		if (bytes>0 and bytes+size>budget) return false;
+		Model::PreparedPart part = std::move(job->ready.front());
+		job->ready.pop_front();
+		lock.unlock();
+		uploaded.emplace_back(std::move(part));
+		bytes += size;
+	}
+}
+
+void ModelLoader::joinDiscarded(bool wait) {
+	for(size_t i=0;i<discarded.size();) {
+		bool done;
+		{
+			std::lock_guard<std::mutex> lock(discarded[i]->mutex);
+			done = discarded[i]->done;
+		}
+		if (done or wait) {
+			discarded[i]->worker.join();
+			discarded.erase(discarded.begin()+i);
+		} else
+			++i;
+	}
+}
+
+ModelLoader::~ModelLoader() {
+	if (job) discarded.push_back(std::move(job));
+	joinDiscarded(true);
+}
+
@@ -0,0 +1,49 @@
+#ifndef MODELLOADER_HPP
+#define MODELLOADER_HPP
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <vector>
+#include "Model.hpp"
+
+// loads models in a worker thread: the parsing and the building of the
+// geometries (see Model::prepare) are done there, and the main thread only
+// sends the finished parts to the GPU, a few per frame (see update), so it
+// can keep drawing the previous model meanwhile
+class ModelLoader {
+public:
+	ModelLoader() = default;
+	// starts loading a model (same arguments as Model::load, but fStream is
+	// not supported); a previous request still in progress is discarded
+	void request(const std::string &name, int flags = 0);
+	// uploads the parts already prepared by the worker, while the sizes of their
+	// buffers (in bytes) do not exceed budget (but at least one part per call);
+	// when the last part of the requested model is uploaded, it replaces the
+	// contents of models and returns true (otherwise, models is not modified);
+	// errors from the worker are rethrown here; in a benchmark (see Benchmark)
+	// it waits for the worker and uploads everything, without budget
+	bool update(std::vector<Model> &models, size_t budget = 4*1024*1024);
+	bool isLoading() const { return job!=nullptr; }
+	~ModelLoader();
+private:
+	ModelLoader(const ModelLoader &) = delete;
+	ModelLoader &operator=(const ModelLoader &) = delete;
+	// shared between the main thread and the worker
+	struct Job {
+		std::mutex mutex;
+		std::deque<Model::PreparedPart> ready;
+		bool done = false;
+		std::exception_ptr error;
+		std::thread worker;
+	};
+	std::shared_ptr<Job> job;
+	std::vector<std::shared_ptr<Job>> discarded; // still running, joined when done
+	std::vector<Model> uploaded; // parts of the current job already in the GPU
+	void joinDiscarded(bool wait);
+};
+
+#endif
+
@@ -0,0 +1,35 @@
+#ifndef TEXTURELOADER_HPP
+#define TEXTURELOADER_HPP
+
+#include <string>
+#include <glad/glad.h>
+
+// loads the textures created with async=true in three stages: a pool of
+// worker threads decodes the images and builds their mipmaps (or reads their
+// compressed files, see CompressedImage, and generates them if needed), and
+// the main thread (in update) sends the levels to the GPU through a pixel
+// unpack buffer, a few per frame (or parts of a level for the large ones) and
+// from the smallest to the largest one; each texture only uses the levels
+// already uploaded (GL_TEXTURE_BASE_LEVEL), so it looks blurry at first and
+// gets sharper until it is complete
+class TextureLoader {
+public:
+	// used by Texture: the texture object already has all its levels allocated
+	// (format is GL_RGBA, or the format of the compressed file to use)
+	static void request(GLuint texture_id, const std::string &fname, int width, int height, GLenum format);
+	static void cancel(GLuint texture_id);
+	static bool isPending(GLuint texture_id);
+
+	// uploads the levels already decoded, up to budget bytes (the large levels
+	// are split in groups of rows, at least one row per call); it must be called
+	// once per frame, before drawing; returns true while something is still
+	// pending; errors from the workers are reported here; in a benchmark (see
+	// Benchmark) it waits for the workers and uploads everything, without budget
+	static bool update(size_t budget = 4*1024*1024);
+
+	// number of mipmap levels (down to 1x1) for an image of width x height
+	static int levelsCount(int width, int height);
+};
+
+#endif
+
@@ -1,10 +1,12 @@
 #include <cmath>
 #include "Car.hpp"
+#include "Profiler.hpp"
 
 constexpr float PI = 3.14159265359f;
 constexpr float G2R = PI/180.f;
 
 void Car::Move(const Track &track, float acel, float dir, bool analog) {
+	PROFILE_SCOPE("Car::Move");
 	// frenar si se sale de la pista
 	if ((not track.isAsphalt(x,y)) && vel>top_speed/4) {
 		acel = -1; dir /= 2;
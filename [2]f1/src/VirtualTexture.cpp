@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stb_image.h>
+#include "VirtualTexture.hpp"
+#include "CompressedImage.hpp"
+#include "Benchmark.hpp"
+#include "Debug.hpp"
+
+namespace {
+
+// texels que se copian alrededor de cada tile en la cach (un bloque, si est
+// comprimida); tambin limita el filtrado anisotrpico, para que sus muestras
+// no salgan del borde
+const int border = 4;
+
+// separacin (en pixeles) entre los rayos con que se buscan los tiles visibles
+const int sample_step = 8;
+
+}
+
+VirtualTexture::VirtualTexture(const std::string &fname, int tile_size, int slots)
+	: fname(fname), tile_size(tile_size), slots(slots), slot_size(tile_size+2*border)
+{
+	// si hay una versin comprimida (y actualizada), se usa esa, con sus mipmaps
+	int width, height, channels;
+	CompressedImage compressed;
+	if (GLAD_GL_EXT_texture_compression_s3tc and readCompressedImage(fname,compressed,true)) {
+		format = compressed.format; width = compressed.width; height = compressed.height;
+	} else
+		cg_assert(stbi_info(fname.c_str(),&width,&height,&channels),"Could not load texture "+fname);
+	cg_assert(width==height and (width&(width-1))==0 and width>=tile_size and tile_size%4==0 and slots<=256,
+			  "Invalid size for virtual texture "+fname);
+	size = width; tiles = size/tile_size;
+	for(levels=1; (tiles>>(levels-1))>1; ++levels);
+
+	// las pages de todos los niveles, del ms fino al ms grueso
+	for(int l=0;l<levels;++l) {
+		level_offsets.push_back(pages.size());
+		for(int y=0;y<(tiles>>l);++y)
+			for(int x=0;x<(tiles>>l);++x)
+				pages.push_back({l,x,y});
+	}
+	slot_pages.resize(slots*slots,-1);
+
+	// la cach, sin mipmaps (cada tile ya es del nivel que corresponde)
+	int cache_size = slots*slot_size;
+	glGenTextures(1,&cache_id);
+	glBindTexture(GL_TEXTURE_2D,cache_id);
+	if (format==GL_RGBA)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cache_size, cache_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	else
+		glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, cache_size, cache_size, 0,
+							   (cache_size/4)*(cache_size/4)*CompressedImage::blockSize(format), nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	// el filtrado anisotrpico se configura una sola vez, ac
+	if (GLAD_GL_EXT_texture_filter_anisotropic) {
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+		max_anisotropy = std::min(max_anisotropy,float(2*border));
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotropy);
+	}
+
+	// la tabla de indireccin: para cada tile, el slot (x,y) del que lo
+	// reemplaza, su nivel, y 255 (0 si todava no hay ninguno)
+	glGenTextures(1,&table_id);
+	glBindTexture(GL_TEXTURE_2D,table_id);
+	for(int l=0;l<levels;++l)
+		glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8UI, tiles>>l, tiles>>l, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels-1);
+	updateTable();
+
+	// la imagen se carga en otro hilo; si no estaba comprimida, despus de
+	// entregarla genera la versin comprimida para la prxima vez (como
+	// TextureLoader, desde los pixeles decodificados, as no se copia la
+	// pirmide, y la abandona si se destruye la textura)
+	std::promise<Pyramid> promise;
+	loading = promise.get_future();
+	worker = std::thread([fname,format=format,size=size,levels=levels,closing=&closing](std::promise<Pyramid> promise) {
+		Pyramid pyramid;
+		unsigned char *data = nullptr;
+		if (format!=GL_RGBA) {
+			CompressedImage image;
+			if (readCompressedImage(fname,image) and image.format==format and
+				image.width==size and int(image.levels.size())>=levels)
+				pyramid = std::move(image.levels);
+		} else {
+			int w, h, c;
+			stbi_set_flip_vertically_on_load(true); // igual que Texture
+			data = stbi_load(fname.c_str(), &w, &h, &c, 4);
+			if (data and w==size and h==size)
+				pyramid = buildMipmaps(data,w,h);
+		}
+		if (pyramid.empty()) { stbi_image_free(data); promise.set_value(Pyramid()); return; }
+		pyramid.resize(levels);
+		promise.set_value(std::move(pyramid));
+		if (format==GL_RGBA and GLAD_GL_EXT_texture_compression_s3tc) {
+			CompressedImage image = compressImage(data,size,size,[closing]() { return closing->load(); });
+			if (not image.levels.empty() and not writeCompressedImage(fname,image))
+				cg_info("Could not write compressed texture for: " + fname);
+		}
+		stbi_image_free(data);
+	},std::move(promise));
+}
+
+VirtualTexture::~VirtualTexture() {
+	closing = true;
+	if (worker.joinable()) worker.join();
+	glDeleteTextures(1,&cache_id);
+	glDeleteTextures(1,&table_id);
+}
+
+int VirtualTexture::unitPixels() const {
+	return format==GL_RGBA ? 1 : 4;
+}
+
+int VirtualTexture::unitBytes() const {
+	return format==GL_RGBA ? 4 : CompressedImage::blockSize(format);
+}
+
+void VirtualTexture::update(const glm::mat4 &view, const glm::mat4 &projection, int viewport_width,
+							int viewport_height, const glm::mat3 &plane_to_uv, int max_uploads)
+{
+	last_uploads = 0;
+	if (pyramid.empty()) {
+		// en un benchmark se espera al hilo, para que el resultado no dependa de
+		// cunto tarde
+		if (Benchmark::isActive() and loading.valid()) loading.wait();
+		if (not loading.valid() or loading.wait_for(std::chrono::seconds(0))!=std::future_status::ready) return;
+		pyramid = loading.get();
+		if (pyramid.empty()) { cg_error("Could not load texture "+fname); return; }
+	}
+	++frame;
+	// el tile ms grueso (toda la imagen) est siempre, para que nunca falte nada
+	pages.back().frame = frame;
+
+	// un rayo por cada punto de la grilla (en pixeles), y dnde toca al plano
+	glm::mat4 inv = glm::inverse(projection*view);
+	int nx = viewport_width/sample_step+1, ny = viewport_height/sample_step+1;
+	sample_uvs.resize(nx*ny); sample_hits.resize(nx*ny);
+	for(int j=0;j<ny;++j) {
+		for(int i=0;i<nx;++i) {
+			glm::vec2 ndc(2.f*i*sample_step/viewport_width-1.f, 2.f*j*sample_step/viewport_height-1.f);
+			glm::vec4 p0 = inv*glm::vec4(ndc,-1.f,1.f), p1 = inv*glm::vec4(ndc,1.f,1.f);
+			glm::vec3 a = glm::vec3(p0)/p0.w, b = glm::vec3(p1)/p1.w;
+			float t = a.y==b.y ? -1.f : a.y/(a.y-b.y);
+			sample_hits[j*nx+i] = t>=0.f and t<=1.f;
+			if (not sample_hits[j*nx+i]) continue;
+			glm::vec3 p = a+(b-a)*t;
+			sample_uvs[j*nx+i] = glm::vec2(plane_to_uv*glm::vec3(p.x,p.z,1.f));
+		}
+	}
+
+	// el nivel de cada punto, con las derivadas (en texels del nivel 0 por
+	// pixel) respecto a los vecinos de la grilla, igual que en el shader
+	auto derivative = [&](int i, int j, int di, int dj, glm::vec2 &d) {
+		for(int s : {1,-1}) {
+			int ni = i+s*di, nj = j+s*dj;
+			if (ni<0 or nj<0 or ni>=nx or nj>=ny or not sample_hits[nj*nx+ni]) continue;
+			d = (sample_uvs[nj*nx+ni]-sample_uvs[j*nx+i])*float(s*size)/float(sample_step);
+			return true;
+		}
+		return false;
+	};
+	for(int j=0;j<ny;++j) {
+		for(int i=0;i<nx;++i) {
+			if (not sample_hits[j*nx+i]) continue;
+			glm::vec2 dx, dy;
+			bool has_dx = derivative(i,j,1,0,dx), has_dy = derivative(i,j,0,1,dy);
+			if (not has_dx and not has_dy) continue;
+			if (not has_dx) dx = dy; else if (not has_dy) dy = dx;
+			float lx = glm::length(dx), ly = glm::length(dy);
+			float lod = std::log2(std::max(std::max(std::min(lx,ly),std::max(lx,ly)/max_anisotropy),1e-6f));
+			markNeeded(sample_uvs[j*nx+i],lod);
+		}
+	}
+
+	// los que faltan, de los ms gruesos a los ms finos (las pages estn
+	// ordenadas por nivel), as primero se ve borroso y despus se va afinando
+	for(int i=int(pages.size())-1; i>=0 and last_uploads<max_uploads; --i) {
+		Page &page = pages[i];
+		if (page.frame!=frame or page.slot!=-1) continue;
+		// un slot libre, o el del tile que hace ms tiempo que no se necesita
+		int slot = -1;
+		for(int s=0;s<slots*slots;++s) {
+			if (slot_pages[s]==-1) { slot = s; break; }
+			unsigned used = pages[slot_pages[s]].frame;
+			if (used!=frame and (slot==-1 or used<pages[slot_pages[slot]].frame)) slot = s;
+		}
+		if (slot==-1) break; // no entra todo lo visible, lo que falta usa los ms gruesos
+		if (slot_pages[slot]!=-1) {
+			pages[slot_pages[slot]].slot = -1;
+			--resident_count;
+		}
+		upload(i,slot);
+		slot_pages[slot] = i; page.slot = slot;
+		++resident_count; ++last_uploads;
+		table_dirty = true;
+	}
+	if (table_dirty) updateTable();
+}
+
+void VirtualTexture::markNeeded(const glm::vec2 &uv, float lod) {
+	int level = std::min(std::max(int(std::floor(lod)),0),levels-1);
+	glm::vec2 f = uv-glm::floor(uv); // la imagen se repite en la pista
+	// el tile de ese nivel y los que lo contienen (los reemplazan mientras no est)
+	for(int l=level;l<levels;++l) {
+		int n = tiles>>l;
+		Page &page = pages[pageIndex(l,std::min(int(f.x*n),n-1),std::min(int(f.y*n),n-1))];
+		if (page.frame==frame) break; // entonces los de arriba tambin
+		page.frame = frame;
+	}
+}
+
+void VirtualTexture::upload(int page_index, int slot) {
+	// el tile con su borde (que sale de los vecinos, dando la vuelta en los
+	// bordes de la imagen, porque se repite), en pixeles o en bloques de 4x4
+	const Page &page = pages[page_index];
+	const std::vector<unsigned char> &src = pyramid[page.level];
+	int upx = unitPixels(), ub = unitBytes();
+	int level_units = (size>>page.level)/upx, tile_units = tile_size/upx,
+		border_units = border/upx, slot_units = slot_size/upx;
+	staging.resize(size_t(slot_units)*slot_units*ub);
+	for(int y=0;y<slot_units;++y) {
+		int sy = (page.y*tile_units+y-border_units+level_units)%level_units;
+		for(int x=0;x<slot_units;++x) {
+			int sx = (page.x*tile_units+x-border_units+level_units)%level_units;
+			std::memcpy(&staging[(size_t(y)*slot_units+x)*ub],&src[(size_t(sy)*level_units+sx)*ub],ub);
+		}
+	}
+	int x0 = slot%slots*slot_size, y0 = slot/slots*slot_size;
+	glBindTexture(GL_TEXTURE_2D,cache_id);
+	if (format==GL_RGBA)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, slot_size, slot_size, GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+	else
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, slot_size, slot_size, format, staging.size(), staging.data());
+}
+
+void VirtualTexture::updateTable() {
+	// del nivel ms grueso al ms fino: lo que no est usa lo de su "padre"
+	Pyramid table(levels);
+	for(int l=levels-1;l>=0;--l) {
+		int n = tiles>>l;
+		table[l].resize(size_t(n)*n*4,0);
+		for(int y=0;y<n;++y) {
+			for(int x=0;x<n;++x) {
+				unsigned char *entry = &table[l][(size_t(y)*n+x)*4];
+				const Page &page = pages[pageIndex(l,x,y)];
+				if (page.slot!=-1) {
+					entry[0] = page.slot%slots; entry[1] = page.slot/slots;
+					entry[2] = l; entry[3] = 255;
+				} else if (l+1<levels)
+					std::memcpy(entry,&table[l+1][(size_t(y/2)*(n/2)+x/2)*4],4);
+			}
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D,table_id);
+	for(int l=0;l<levels;++l)
+		glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, tiles>>l, tiles>>l, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, table[l].data());
+	table_dirty = false;
+}
+
+void VirtualTexture::bind(Shader &shader) const {
+	// los uniforms son siempre los mismos, se setean la primera vez
+	if (setup_program!=shader.getProgramId()) {
+		shader.setUniform(shader.getUniform<int>("cacheTexture"),0);
+		shader.setUniform(shader.getUniform<int>("indirectionTexture"),1);
+		shader.setUniform(shader.getUniform<float>("tileSize"),float(tile_size));
+		shader.setUniform(shader.getUniform<float>("tileBorder"),float(border));
+		shader.setUniform(shader.getUniform<float>("maxLevel"),float(levels-1));
+		shader.setUniform(shader.getUniform<float>("maxAnisotropy"),max_anisotropy);
+		setup_program = shader.getProgramId();
+	}
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D,table_id);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D,cache_id);
+}
+
+size_t VirtualTexture::memorySize() const {
+	size_t cache_size = slots*slot_size;
+	return cache_size*cache_size*(format==GL_RGBA ? 32 : CompressedImage::bitsPerPixel(format))/8
+		+ size_t(tiles)*tiles*4*4/3;
+}
+
+glm::mat3 VirtualTexture::planeMapping(const Geometry &geo) {
+	int i0 = 0, i1 = 1, i2 = 2;
+	if (not geo.triangles.empty()) { i0 = geo.triangles[0]; i1 = geo.triangles[1]; i2 = geo.triangles[2]; }
+	auto xz = [&](int i) { return glm::vec2(geo.positions[i].x,geo.positions[i].z); };
+	// uv = A*(x,z)+c, con A tal que lleva los lados del tringulo a los de sus coordenadas de textura
+	glm::mat2 sides(xz(i1)-xz(i0),xz(i2)-xz(i0));
+	glm::mat2 tex_sides(geo.tex_coords[i1]-geo.tex_coords[i0],geo.tex_coords[i2]-geo.tex_coords[i0]);
+	glm::mat2 A = tex_sides*glm::inverse(sides);
+	glm::vec2 c = geo.tex_coords[i0]-A*xz(i0);
+	return glm::mat3(glm::vec3(A[0],0.f),glm::vec3(A[1],0.f),glm::vec3(c,1.f));
+}
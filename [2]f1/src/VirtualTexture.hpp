@@ -0,0 +1,94 @@
+#ifndef VIRTUALTEXTURE_HPP
+#define VIRTUALTEXTURE_HPP
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Geometry.hpp"
+#include "Shaders.hpp"
+
+// textura "virtual" para la pista: la imagen se divide en tiles (de
+// tile_size x tile_size texels) en cada uno de sus niveles de mipmap, y en la
+// GPU solo estn los tiles que la cmara necesita, dentro de una textura
+// "cach" de tamao fijo (slots x slots tiles, cada uno con un borde copiado
+// de sus vecinos para que el filtrado no mezcle tiles); una tabla de
+// indireccin (una textura con un texel por tile, y un nivel de mipmap por
+// cada nivel de la imagen) le dice al shader (shaders/virtualTexture.frag)
+// dnde est cada tile en la cach, o el del nivel ms grueso que s est
+class VirtualTexture {
+public:
+	// la imagen debe ser cuadrada, potencia de 2 y de al menos tile_size; se
+	// decodifica en otro hilo (o se lee su versin comprimida, ver
+	// CompressedImage), y mientras tanto la pista se ve gris
+	VirtualTexture(const std::string &fname, int tile_size=128, int slots=16);
+	~VirtualTexture();
+
+	// marca los tiles que necesita la cmara (lanzando rayos a travs de la
+	// pantalla contra el plano y=0, en una grilla, y calculando para cada punto
+	// el nivel de mipmap que usara el shader), y sube hasta max_uploads de los
+	// que faltan, los ms gruesos primero; si no hay lugar, reemplaza los que
+	// hace ms tiempo que no se usan; plane_to_uv transforma (x,z,1) del plano
+	// en coordenadas de textura (ver planeMapping); una vez por cuadro (en un
+	// benchmark, la primera vez espera a que termine de cargarse la imagen)
+	void update(const glm::mat4 &view, const glm::mat4 &projection, int viewport_width,
+				int viewport_height, const glm::mat3 &plane_to_uv, int max_uploads=8);
+
+	// activa la cach (unit 0) y la tabla de indireccin (unit 1); el shader
+	// debe estar en uso (sus uniforms se setean solo la primera vez)
+	void bind(Shader &shader) const;
+
+	int residentCount() const { return resident_count; }
+	int uploadsCount() const { return last_uploads; } // en el ltimo update
+	size_t memorySize() const; // de la cach y la tabla, en la GPU
+
+	// la transformacin afn de (x,z,1) a coordenadas de textura de una
+	// geometra plana (horizontal, en y=0), a partir de su primer tringulo
+	static glm::mat3 planeMapping(const Geometry &geo);
+
+private:
+	VirtualTexture(const VirtualTexture &) = delete;
+	VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+	using Pyramid = std::vector<std::vector<unsigned char>>;
+	// datos de cada tile
+	struct Page {
+		int level, x, y;
+		int slot = -1; // lugar en la cach, -1 si no est
+		unsigned frame = 0; // ltimo cuadro en que se necesit
+	};
+	int pageIndex(int level, int x, int y) const { return level_offsets[level]+y*(tiles>>level)+x; }
+	int unitPixels() const; // 1 (RGBA), o 4 (un bloque de 4x4 si est comprimida)
+	int unitBytes() const;
+	void markNeeded(const glm::vec2 &uv, float lod);
+	void upload(int page, int slot);
+	void updateTable();
+
+	std::string fname;
+	int size, levels, tiles; // tamao de la imagen, niveles (hasta el de un solo tile), tiles por lado en el nivel 0
+	int tile_size, slots, slot_size;
+	GLenum format = GL_RGBA; // o el de la versin comprimida
+	float max_anisotropy = 1.f;
+	GLuint cache_id = 0, table_id = 0;
+
+	// la imagen y sus mipmaps (RGBA o comprimidos, en memoria), cuando el hilo termina
+	std::thread worker;
+	std::future<Pyramid> loading;
+	Pyramid pyramid;
+	std::atomic<bool> closing{false}; // para que el hilo no siga comprimiendo al destruirla
+
+	std::vector<Page> pages;
+	std::vector<int> level_offsets; // ndice de la primer page de cada nivel
+	std::vector<int> slot_pages; // page en cada slot de la cach, -1 si est libre
+	std::vector<unsigned char> staging; // auxiliar para armar cada tile con su borde
+	std::vector<glm::vec2> sample_uvs; // auxiliares para los rayos de update
+	std::vector<char> sample_hits;
+	unsigned frame = 0;
+	int resident_count = 0, last_uploads = 0;
+	bool table_dirty = true;
+	mutable GLuint setup_program = 0; // el ltimo shader al que se le setearon los uniforms
+};
+
+#endif
@@ -7,11 +7,16 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include "Model.hpp"
+#include "AssetCache.hpp"
 #include "Window.hpp"
 #include "Callbacks.hpp"
 #include "Debug.hpp"
 #include "Shaders.hpp"
 #include "Car.hpp"
+#include "TextureLoader.hpp"
+#include "VirtualTexture.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20220901.2
 
@@ -25,6 +30,11 @@ void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, i
 // entradas para el control del auto
 std::tuple<float,float,bool> getInput(GLFWwindow *window);
 
+// entradas simuladas para el modo benchmark: teclas, y un "piloto automtico"
+// que reemplaza a getInput
+void benchmarkInput(GLFWwindow *window, int frame);
+std::tuple<float,float,bool> getAutopilotInput(const Car &car, const Track &track);
+
 // matrices que definen la camara
 glm::mat4 projection_matrix, view_matrix;
 
@@ -32,18 +42,16 @@ glm::mat4 projection_matrix, view_matrix;
 struct Part {
 	std::string name;
 	bool show;
-	std::vector<Model> models;
+	AssetCache::ModelsHandle models;
 };
 
 // funcin para renderizar cada "parte" del auto
-void renderPart(const Car &car, const std::vector<Model> &v_models, const glm::mat4 &matrix) {
-	static Shader shader("shaders/phong");
-	
-	// select a shader
+void renderPart(Shader &shader, const Car &car, const std::vector<Model> &v_models, const glm::mat4 &matrix) {
 	for(const Model &model : v_models) {
 		shader.use();
 		
 		// matrixes
+		glm::mat4 model_matrix;
 		if (play) {
 			/// @todo: modificar una de estas matrices para mover todo el auto (todas
 			///        las partes) a la posicin (y orientacin) que le corresponde en la pista
@@ -51,37 +59,38 @@ void renderPart(const Car &car, const std::vector<Model> &v_models, const glm::m
 						0.f, 1.f, 0.f, 0.f,
 						-std::sin(car.ang), 0.f, std::cos(car.ang), 0.f,
 						car.x, 0.f, car.y, 1.f);
-			shader.setMatrixes(M*matrix,view_matrix,projection_matrix);
+			model_matrix = M*matrix;
 		} else {
-			glm::mat4 model_matrix = glm::rotate(glm::mat4(1.f),view_angle,glm::vec3{1.f,0.f,0.f}) *
-						             glm::rotate(glm::mat4(1.f),model_angle,glm::vec3{0.f,1.f,0.f}) *
-			                         matrix;
-			shader.setMatrixes(model_matrix,view_matrix,projection_matrix);
+			model_matrix = glm::rotate(glm::mat4(1.f),view_angle,glm::vec3{1.f,0.f,0.f}) *
+						   glm::rotate(glm::mat4(1.f),model_angle,glm::vec3{0.f,1.f,0.f}) *
+			               matrix;
 		}
+		shader.setModelMatrix(model_matrix);
 		
-		// setup light and material
-		shader.setLight(glm::vec4{20.f,-20.f,-40.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.35f);
-		shader.setMaterial(model.material);
+		// setup material (camera and light are in FrameData)
+		shader.setMaterial(model.material_index);
 		
-		// send geometry
-		shader.setBuffers(model.buffers);
+		// send geometry (simplified if the car is far away)
+		const GeometryRenderer &buffers = model.selectLod(view_matrix*model_matrix,projection_matrix,win_height);
+		shader.setBuffers(buffers);
 		glPolygonMode(GL_FRONT_AND_BACK,(wireframe and (not play))?GL_LINE:GL_FILL);
-		model.buffers.draw();
+		buffers.draw();
 	}
 }
 
-// funcin que renderiza la pista
-void RenderTrack() {
-	static Model track = Model::loadSingle("track",Model::fDontFit);
-	static Shader shader("shaders/texture");
+// funcin que renderiza la pista; su textura no est toda en la GPU, solo
+// los tiles que se ven desde la cmara actual (ver VirtualTexture)
+void RenderTrack(const Model &track, Shader &shader, VirtualTexture &texture, const glm::mat3 &plane_to_uv) {
+	{
+		PROFILE_SCOPE("VirtualTexture::update");
+		texture.update(view_matrix,projection_matrix,win_width,win_height,plane_to_uv);
+	}
+	PROFILE_GPU_SCOPE("pista");
 	shader.use();
-	shader.setMatrixes(glm::mat4(1.f),view_matrix,projection_matrix);
-	shader.setMaterial(track.material);
+	shader.setModelMatrix(glm::mat4(1.f));
+	shader.setMaterial(track.material_index);
 	shader.setBuffers(track.buffers);
-	track.texture.bind();
-	static float aniso = -1.0f;
-	if (aniso<0) glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso); 
+	texture.bind(shader);
 	glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
 	track.buffers.draw();
 }
@@ -116,7 +125,9 @@ void setViewAndProjectionMatrixes( Car &car ) {
 }
 
 // funcin que rendiriza todo el auto, parte por parte
-void renderCar(const Car &car, const std::vector<Part> &parts) {
+void renderCar(Shader &shader, const Car &car, const std::vector<Part> &parts) {
+	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE("auto");
 	const Part &axis = parts[0], &body = parts[1], &wheel = parts[2],
 	           &fwing = parts[3], &rwing = parts[4], &helmet = parts[5];
 	
@@ -139,7 +150,7 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 					  0.f, 1.f, 0.f, 0.f,
 					  0.f, 0.f, 1.f, 0.f,
 					  0.f, 0.2f, 0.f, 1.f);
-		renderPart(car,body.models, M);
+		renderPart(shader,car,*body.models, M);
 	}
 	
 	if (wheel.show or play) {
@@ -166,28 +177,28 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 					  0.f, wscl, 0.f, 0.f,
 					  0.f, 0.f, wscl, 0.f,
 					  0.5f, 0.2f, -0.4f, 1.f);
-		renderPart(car,wheel.models, M*MdirIzq*MtraccionIzq);
+		renderPart(shader,car,*wheel.models, M*MdirIzq*MtraccionIzq);
 		
 		///Adelante der
 		M = glm::mat4(wscl, 0.f, 0.f, 0.f,
 					  0.f, wscl, 0.f, 0.f,
 					  0.f, 0.f, -wscl, 0.f,
 					  0.5f, 0.2f, 0.4f, 1.f);
-		renderPart(car,wheel.models, M*MdirDer*MtraccionDer);
+		renderPart(shader,car,*wheel.models, M*MdirDer*MtraccionDer);
 		
 		///Atras izq
 		M = glm::mat4(wscl, 0.f, 0.f, 0.f,
 					  0.f, wscl, 0.f, 0.f,
 					  0.f, 0.f, wscl, 0.f,
 					  -0.9f, 0.2f, -0.4f, 1.f);
-		renderPart(car,wheel.models, M*MtraccionIzq);
+		renderPart(shader,car,*wheel.models, M*MtraccionIzq);
 		
 		///Atras der
 		M = glm::mat4(wscl, 0.f, 0.f, 0.f,
 					  0.f, wscl, 0.f, 0.f,
 					  0.f, 0.f, -wscl, 0.f,
 					  -0.9f, 0.2f, 0.4f, 1.f);
-		renderPart(car,wheel.models, M*MtraccionDer);
+		renderPart(shader,car,*wheel.models, M*MtraccionDer);
 	}
 	
 	if (fwing.show or play) {
@@ -195,7 +206,7 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 					  0.f, 0.5f, 0.f, 0.f,
 					  -0.3f, 0.f, 0.f, 0.f,
 					  0.9f, 0.2f, 0.f, 1.f);
-		renderPart(car,fwing.models, M);
+		renderPart(shader,car,*fwing.models, M);
 	}
 	
 	if (rwing.show or play) {
@@ -204,7 +215,7 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 					  0.f, -scl, 0.f, 0.f,
 					  scl, 0.f, 0.f, 0.f,
 					  -1.f, 0.5f, 0.f, 1.f);
-		renderPart(car,rwing.models, M);
+		renderPart(shader,car,*rwing.models, M);
 	}
 	
 	if (helmet.show or play) {
@@ -212,14 +223,17 @@ void renderCar(const Car &car, const std::vector<Part> &parts) {
 					  0.f, 0.1, 0.f, 0.f,
 					  -0.1f, 0.f, 0.f, 0.f,
 					  0.f, 0.3f, 0.f, 1.f);
-		renderPart(car,helmet.models, M);
+		renderPart(shader,car,*helmet.models, M);
 	}
 	
-	if (axis.show and (not play)) renderPart(car,axis.models,glm::mat4(1.f));
+	if (axis.show and (not play)) renderPart(shader,car,*axis.models,glm::mat4(1.f));
 }
 
 // main: crea la ventana, carga los modelos e implementa el bucle principal
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" corre un benchmark sin ventana visible (ver Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Demo",true);
@@ -231,18 +245,26 @@ int main() {
 	glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 	glClearColor(0.4f,0.4f,0.8f,1.f);
 	
+	// los modelos y shaders son locales de main para que se liberen antes de
+	// destruir la ventana (y con ella el contexto de OpenGL)
+	AssetCache::ShaderHandle car_shader = AssetCache::shader("shaders/phong");
+	AssetCache::ShaderHandle track_shader = AssetCache::shader("shaders/texture.vert","shaders/virtualTexture.frag");
+	AssetCache::ModelsHandle track_models = AssetCache::models("track",Model::fDontFit|Model::fKeepGeometry);
+	glm::mat3 plane_to_uv = VirtualTexture::planeMapping(track_models->front().geometry);
+	
 	// main loop
 	std::vector<Part> parts; parts.reserve(8);
-	parts.push_back({"axis",      true,Model::load("axis",      Model::fDontFit)});
-	parts.push_back({"body",      true,Model::load("body",      Model::fDontFit)});
-	parts.push_back({"wheels",    true,Model::load("wheel",     Model::fDontFit)});
-	parts.push_back({"front wing",true,Model::load("front_wing",Model::fDontFit)});
-	parts.push_back({"rear wing", true,Model::load("rear_wing", Model::fDontFit)});
-	parts.push_back({"driver",    true,Model::load("driver",    Model::fDontFit)});
+	parts.push_back({"axis",      true,AssetCache::models("axis",      Model::fDontFit|Model::fLods)});
+	parts.push_back({"body",      true,AssetCache::models("body",      Model::fDontFit|Model::fLods)});
+	parts.push_back({"wheels",    true,AssetCache::models("wheel",     Model::fDontFit|Model::fLods)});
+	parts.push_back({"front wing",true,AssetCache::models("front_wing",Model::fDontFit|Model::fLods)});
+	parts.push_back({"rear wing", true,AssetCache::models("rear_wing", Model::fDontFit|Model::fLods)});
+	parts.push_back({"driver",    true,AssetCache::models("driver",    Model::fDontFit|Model::fLods)});
 	
 	Car car(+66,-35,1.38);
 	
 	Track track("mapa.png",100,100);
+	VirtualTexture track_texture("models/track_4096.png");
 	
 	FrameTimer ftime;
 	double accum_dt = 0.0;
@@ -250,13 +272,23 @@ int main() {
 	double last_lap = 0.0;
 	do {
 		
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(window,Benchmark::getFrame());
+		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
+		// bsquedas por nombre en los shaders durante el cuadro anterior (deberan ser 0)
+		int shader_lookups = Shader::getLookupCount();
+		Shader::resetLookupCount();
+		
+		// subir un poco ms de las texturas que an se estn cargando
+		TextureLoader::update();
+		
 		// actualizar las pos del auto y de la camara
 		double elapsed_time = ftime.newFrame();
 		accum_dt += elapsed_time;
 		if (play) lap_time += elapsed_time;
-		auto in = getInput(window);
+		auto in = Benchmark::isActive() ? getAutopilotInput(car,track) : getInput(window);
 		while (accum_dt>1.0/60.0) { 
 			car.Move(track,std::get<0>(in),std::get<1>(in),std::get<2>(in));
 			if (track.isFinishLine(car.x,car.y) and lap_time>5) {
@@ -267,9 +299,15 @@ int main() {
 			setViewAndProjectionMatrixes(car);
 		}
 		
-		// setear matrices y renderizar
-		if (play) RenderTrack();
-		renderCar(car,parts);
+		// setear matrices (camara y luz, una vez para todos los shaders) y renderizar
+		FrameData frame_data;
+		frame_data.view_matrix = view_matrix;
+		frame_data.projection_matrix = projection_matrix;
+		frame_data.light_position = glm::vec4{20.f,-20.f,-40.f,0.f};
+		frame_data.ambient_strength = 0.35f;
+		frame_data.upload();
+		if (play) RenderTrack(track_models->front(),*track_shader,track_texture,plane_to_uv);
+		renderCar(*car_shader,car,parts);
 		
 		// settings sub-window
 		window.ImGuiDialog("CG Example",[&](){
@@ -277,6 +315,7 @@ int main() {
 			if (play) {
 				ImGui::LabelText("","Lap Time: %f s",lap_time<5 ? last_lap : lap_time);
 				ImGui::Checkbox("Top View (T)",&top_view);
+				ImGui::Text("Track tiles: %i (%i new)",track_texture.residentCount(),track_texture.uploadsCount());
 			} else {
 				ImGui::Checkbox("Wireframe (W)",&wireframe);
 				if (ImGui::TreeNode("Parts")) {
@@ -295,13 +334,15 @@ int main() {
 				ImGui::LabelText("","rang2: %f",car.rang2);
 				ImGui::TreePop();
 			}
+			ImGui::Text("Shader lookups: %i",shader_lookups);
+			Profiler::drawImGui();
 		});
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
 }
 
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods) {
@@ -326,3 +367,28 @@ std::tuple<float,float,bool> getInput(GLFWwindow *window) {
 	if (count) { dir = axes[0]; acel = -axes[1]; analog = true; }
 	return std::make_tuple(acel,dir,analog);
 }
+
+// arrancar en modo juego, y cambiar la cmara cada 10s
+void benchmarkInput(GLFWwindow *window, int frame) {
+	if (frame==0) keyboardCallback(window,'P',0,GLFW_PRESS,0);
+	if (frame%600==599) keyboardCallback(window,'T',0,GLFW_PRESS,0);
+}
+
+// entre varias direcciones cercanas a la del auto, elige la que tiene ms 
+// asfalto por delante (ante un empate, la ms recta); y frena si ninguna
+// tiene suficiente y va rpido
+std::tuple<float,float,bool> getAutopilotInput(const Car &car, const Track &track) {
+	auto wrap = [](float v, float size) { return v<-size ? v+2*size : (v>size ? v-2*size : v); };
+	int best = 0; float best_dist = -1.f;
+	for(int k=0;k<13;++k) {
+		int i = (k+1)/2*(k%2?-1:1); // 0, -1, 1, -2, 2...
+		float a = car.ang+.1f*i, dist = 0.f;
+		while (dist<20.f and track.isAsphalt(wrap(car.x+dist*std::cos(a),track.Width()),
+											  wrap(car.y+dist*std::sin(a),track.Height())))
+			dist += .5f;
+		if (dist>best_dist) { best = i; best_dist = dist; }
+	}
+	float acel = (best_dist<8.f and car.vel>car.top_speed/2) ? -1.f : 1.f;
+	float dir = std::min(std::max(best/3.f,-1.f),1.f);
+	return std::make_tuple(acel,dir,false);
+}
@@ -0,0 +1,156 @@
+#ifdef _WIN32
+#	define NOMINMAX
+#	define PSAPI_VERSION 2 // GetProcessMemoryInfo from kernel32, no need for psapi.lib
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <sys/resource.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <glad/glad.h>
+#include "Benchmark.hpp"
+#include "Profiler.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct State {
+	int frames_count = 0; // 0 if not active
+	int frame = 0;
+	std::string out_name; // empty for stdout
+	Clock::time_point start, prev;
+	double first_frame = 0.0; // seconds, with the loading
+	std::vector<double> times; // of the following ones, in seconds
+};
+
+State &getState() {
+	static State state;
+	return state;
+}
+
+long peakMemoryKb() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (not GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc))) return -1;
+	return static_cast<long>(pmc.PeakWorkingSetSize/1024);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF,&usage)!=0) return -1;
+#	ifdef __APPLE__
+	return usage.ru_maxrss/1024; // in bytes there
+#	else
+	return usage.ru_maxrss;
+#	endif
+#endif
+}
+
+// nearest rank, v must be sorted and not empty
+double percentile(const std::vector<double> &v, double p) {
+	int i = static_cast<int>(std::ceil(p/100.0*v.size()))-1;
+	return v[std::min(std::max(i,0),int(v.size())-1)];
+}
+
+void writeJsonString(std::ostream &out, const std::string &s) {
+	out << '"';
+	for(char c : s) {
+		if (c=='"' or c=='\\') out << '\\';
+		if (static_cast<unsigned char>(c)>=32) out << c;
+	}
+	out << '"';
+}
+
+}
+
+bool Benchmark::init(int argc, char *argv[]) {
+	State &state = getState();
+	for(int i=1;i<argc;++i) {
+		if (std::strcmp(argv[i],"--bench")==0) {
+			state.frames_count = i+1<argc ? std::max(0,std::atoi(argv[++i])) : 0;
+			if (state.frames_count==0) {
+				std::cerr << "--bench needs the number of frames" << std::endl;
+				return false;
+			}
+		} else if (std::strcmp(argv[i],"--bench-out")==0 and i+1<argc) {
+			state.out_name = argv[++i];
+		}
+	}
+	state.start = state.prev = Clock::now();
+	return true;
+}
+
+bool Benchmark::isActive() {
+	return getState().frames_count>0;
+}
+
+int Benchmark::getFrame() {
+	return getState().frame;
+}
+
+int Benchmark::getFramesCount() {
+	return getState().frames_count;
+}
+
+double Benchmark::getTimeStep() {
+	return 1.0/60.0;
+}
+
+bool Benchmark::nextFrame() {
+	State &state = getState();
+	if (not state.frames_count) return true;
+	Clock::time_point t = Clock::now();
+	double dt = std::chrono::duration<double>(t-state.prev).count();
+	if (state.frame==0) state.first_frame = dt;
+	else state.times.push_back(dt);
+	state.prev = t;
+	if (++state.frame<state.frames_count) return true;
+	
+	if (state.out_name.empty()) {
+		writeReport(std::cout);
+	} else {
+		std::ofstream out(state.out_name);
+		if (not writeReport(out))
+			std::cerr << "Could not write " << state.out_name << std::endl;
+	}
+	return false;
+}
+
+bool Benchmark::writeReport(std::ostream &out) {
+	State &state = getState();
+	std::vector<double> times = state.times;
+	std::sort(times.begin(),times.end());
+	double total = 0.0;
+	for(double t : times) total += t;
+	const char *renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	
+	// times in milliseconds
+	out << std::fixed << std::setprecision(3);
+	out << "{\n  \"frames\": " << state.frame << ",\n  \"time_step\": " << getTimeStep()*1000.0 << ",\n";
+	out << "  \"renderer\": "; writeJsonString(out,renderer?renderer:""); out << ",\n";
+	out << "  \"first_frame\": " << state.first_frame*1000.0 << ",\n";
+	if (not times.empty()) {
+		out << "  \"frame_times\": { \"mean\": " << total/times.size()*1000.0;
+		for(int p : {50,90,95,99})
+			out << ", \"p" << p << "\": " << percentile(times,p)*1000.0;
+		out << ", \"max\": " << times.back()*1000.0 << " },\n";
+	}
+	// each phase in total, and on average per frame
+	out << "  \"phases\": [";
+	bool first = true;
+	for(const Profiler::Total &t : Profiler::getTotals()) {
+		out << (first?"\n":",\n") << "    { \"name\": "; writeJsonString(out,t.name);
+		out << ", \"gpu\": " << (t.gpu?"true":"false") << ", \"count\": " << t.count
+			<< ", \"total\": " << t.seconds*1000.0 << ", \"per_frame\": " << t.seconds*1000.0/std::max(1,state.frame) << " }";
+		first = false;
+	}
+	out << "\n  ],\n  \"peak_memory_kb\": " << peakMemoryKb() << "\n}\n";
+	return bool(out);
+}
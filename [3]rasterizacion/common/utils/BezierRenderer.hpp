@@ -8,33 +8,61 @@ public:
 	BezierRenderer(int nsamples=100);
 	~BezierRenderer();
 	Shader &getShader();
+	// the curve in nsamples uniform samples of t
 	template<typename Bezier>
 	void update(Bezier &b);
+	// the curve as a polyline within tolerance of it (see Bezier::flatten),
+	// with the distances measured after to_screen (to give the tolerance in
+	// pixels); straight or short pieces get only a few vertexes
+	template<typename Bezier, typename F>
+	void update(Bezier &b, float tolerance, const F &to_screen);
+	template<typename Bezier>
+	void update(Bezier &b, float tolerance);
 	void drawPoly();
 	void drawCurve();
 private:
 	Shader shader;
 	GLuint VAO=0, VBO[2]={0,0};
 	std::vector<glm::vec3> v_curve, v_poly;
+	std::vector<float> t_curve; // the values of t for v_curve
+	size_t curve_capacity = 0; // vertexes allocated in VBO[0]
 	glm::vec3 color_curve = {1.f, 1.f, 1.f};
 	glm::vec3 color_poly = {.0f, .0f, .0f};
 	glm::vec3 color_points = {0.f, 0.f, 0.f};
+	template<typename Bezier>
+	void upload(Bezier &b);
+	void uploadBuffers(); // v_curve and v_poly
 };
 
 
 template<typename Bezier>
 void BezierRenderer::update(Bezier &b) {
-	double n = double(v_curve.size())-1;
-	for(size_t i=0;i<v_curve.size();++i)
-		v_curve[i] = b.at(double(i)/n);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, v_curve.size() * sizeof(glm::vec3), v_curve.data());
+	v_curve.resize(t_curve.size());
+	b.evalMany(t_curve.data(),int(t_curve.size()),v_curve.data());
+	upload(b);
+}
+
+template<typename Bezier, typename F>
+void BezierRenderer::update(Bezier &b, float tolerance, const F &to_screen) {
+	v_curve.clear();
+	b.flatten(tolerance,v_curve,to_screen);
+	upload(b);
+}
+
+template<typename Bezier>
+void BezierRenderer::update(Bezier &b, float tolerance) {
+	v_curve.clear();
+	b.flatten(tolerance,v_curve);
+	upload(b);
+}
+
+template<typename Bezier>
+void BezierRenderer::upload(Bezier &b) {
 	v_poly[0] = b[0];
 	v_poly[1] = b[1];
 	v_poly[2] = b[b.degree()-1];
 	v_poly[3] = b[b.degree()];
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, v_poly.size() * sizeof(glm::vec3), v_poly.data());
+	uploadBuffers();
 }
 
 #endif
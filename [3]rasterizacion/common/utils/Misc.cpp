@@ -9,7 +9,7 @@ std::string extractFolder(const std::string &filename) {
 	return filename.substr(0,i+1);
 }
 
-bool startsWith(const std::string str, const char *con) {
+bool startsWith(const std::string &str, const char *con) {
 	int i=0, l=str.size();
 	for(;con[i] && i<l;++i)
 		if (con[i]!=str[i]) return false;
@@ -9,7 +9,7 @@ std::string extractFolder(const std::string &filename);
 
 void fixEOL(std::string &s);
 
-bool startsWith(const std::string str, const char *con);
+bool startsWith(const std::string &str, const char *con);
 
 std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v);
 
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <climits>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include <imgui.h>
+#include "Profiler.hpp"
+#include "Debug.hpp"
+
+constexpr int Profiler::frames_count;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+	const char *name;
+	double begin, end; // seconds since the profiler started
+	int depth, thread; // thread -1 is the GPU
+};
+
+struct Frame {
+	long number = -1;
+	double begin = 0.0, end = 0.0;
+	std::vector<Event> events;
+	bool gpu_ready = false; // the GPU passes are already in events
+};
+
+struct GpuPass {
+	const char *name;
+	int depth;
+	GLuint queries[2]; // timestamps at the begin and at the end
+};
+
+// the GPU passes of a frame, until their queries are available
+struct GpuFrame {
+	long number;
+	double offset; // CPU time - GPU time, measured at the end of the frame
+	std::vector<GpuPass> passes;
+};
+
+struct OpenScope {
+	const char *name;
+	double begin;
+};
+
+struct Profile {
+	std::mutex mutex; // for frames and threads_count (the CPU scopes can be in any thread)
+	Clock::time_point start = Clock::now();
+	std::vector<Frame> frames = std::vector<Frame>(Profiler::frames_count); // ring
+	long frame_number = 0; // the current one is frames[frame_number%frames_count]
+	std::atomic<bool> enabled{true};
+	int threads_count = 0;
+	// main thread only
+	std::vector<GpuPass> gpu_passes; // of the current frame
+	std::vector<int> gpu_stack; // indexes in gpu_passes
+	std::deque<GpuFrame> gpu_pending;
+	std::vector<GLuint> free_queries;
+	std::string export_status;
+	// for getTotals, by name pointer (under mutex)
+	std::map<std::pair<const char*,bool>,std::pair<double,long>> totals;
+	Profile() { frames[0].number = 0; }
+	Frame &current() { return frames[frame_number%Profiler::frames_count]; }
+	// the frame with that number, or null if it is no longer in the ring
+	Frame *find(long number) {
+		Frame &f = frames[number%Profiler::frames_count];
+		return f.number==number ? &f : nullptr;
+	}
+};
+
+Profile &getProfile() {
+	static Profile profile;
+	return profile;
+}
+
+double now(const Profile &profile) {
+	return std::chrono::duration<double>(Clock::now()-profile.start).count();
+}
+
+// per thread: its number in the traces, and the scopes open
+thread_local int thread_id = -1;
+thread_local std::vector<OpenScope> cpu_stack;
+
+GLuint newQuery(Profile &profile) {
+	if (profile.free_queries.empty()) {
+		profile.free_queries.resize(32);
+		glGenQueries(profile.free_queries.size(),profile.free_queries.data());
+	}
+	GLuint q = profile.free_queries.back();
+	profile.free_queries.pop_back();
+	return q;
+}
+
+void addTotal(Profile &profile, const Event &e) {
+	auto &t = profile.totals[{e.name,e.thread==-1}];
+	t.first += e.end-e.begin;
+	++t.second;
+}
+
+// reads the results of the oldest frames whose queries are available
+// (without waiting, unless wait is true), and puts them in their frames (if
+// still in the ring)
+void collectGpu(Profile &profile, bool wait = false) {
+	while (not profile.gpu_pending.empty()) {
+		GpuFrame &gf = profile.gpu_pending.front();
+		GLint available = 1;
+		if (not wait and not gf.passes.empty())
+			glGetQueryObjectiv(gf.passes.back().queries[1],GL_QUERY_RESULT_AVAILABLE,&available);
+		if (not available) break; // the next ones are newer, so not available either
+		std::vector<Event> events;
+		for(GpuPass &p : gf.passes) {
+			GLuint64 t[2];
+			for(int i=0;i<2;++i) {
+				glGetQueryObjectui64v(p.queries[i],GL_QUERY_RESULT,&t[i]);
+				profile.free_queries.push_back(p.queries[i]);
+			}
+			events.push_back({p.name,t[0]*1e-9+gf.offset,t[1]*1e-9+gf.offset,p.depth,-1});
+		}
+		std::lock_guard<std::mutex> lock(profile.mutex);
+		for(const Event &e : events) addTotal(profile,e);
+		if (Frame *f = profile.find(gf.number)) {
+			f->events.insert(f->events.end(),events.begin(),events.end());
+			f->gpu_ready = true;
+		}
+		profile.gpu_pending.pop_front();
+	}
+}
+
+// the newest frame with all its results (CPU and GPU), or null
+const Frame *lastComplete(Profile &profile) {
+	for(long n=profile.frame_number-1;n>=0 and n>profile.frame_number-Profiler::frames_count;--n) {
+		const Frame *f = profile.find(n);
+		if (f and f->gpu_ready) return f;
+	}
+	return nullptr;
+}
+
+ImU32 colorFor(const char *name) {
+	size_t h = std::hash<const void*>()(name);
+	return ImColor::HSV((h%97)/97.f,.5f,.75f);
+}
+
+void writeJsonString(std::ostream &out, const char *s) {
+	out << '"';
+	for(;*s;++s) {
+		if (*s=='"' or *s=='\\') out << '\\';
+		if (static_cast<unsigned char>(*s)>=32) out << *s;
+	}
+	out << '"';
+}
+
+}
+
+void Profiler::newFrame() {
+	Profile &profile = getProfile();
+	cg_assert(profile.gpu_stack.empty(),"A GPU pass is still open at the end of the frame");
+	double t = now(profile);
+	GpuFrame gf{profile.frame_number,0.0,{}};
+	for(const GpuPass &p : profile.gpu_passes)
+		if (p.queries[0]) gf.passes.push_back(p);
+	profile.gpu_passes.clear();
+	if (not gf.passes.empty()) {
+		GLint64 gpu_time; glGetInteger64v(GL_TIMESTAMP,&gpu_time);
+		gf.offset = t-gpu_time*1e-9;
+	}
+	{
+		std::lock_guard<std::mutex> lock(profile.mutex);
+		Frame &f = profile.current();
+		f.end = t;
+		f.gpu_ready = gf.passes.empty();
+		++profile.frame_number;
+		Frame &next = profile.current();
+		next.number = profile.frame_number;
+		next.begin = t;
+		next.events.clear();
+		next.gpu_ready = false;
+	}
+	if (not gf.passes.empty()) profile.gpu_pending.push_back(std::move(gf));
+	collectGpu(profile);
+}
+
+void Profiler::beginCpu(const char *name) {
+	Profile &profile = getProfile();
+	cpu_stack.push_back({name,now(profile)});
+}
+
+void Profiler::endCpu() {
+	Profile &profile = getProfile();
+	cg_assert(not cpu_stack.empty(),"Profiler::endCpu without beginCpu");
+	OpenScope scope = cpu_stack.back();
+	cpu_stack.pop_back();
+	if (not profile.enabled) return;
+	double t = now(profile);
+	std::lock_guard<std::mutex> lock(profile.mutex);
+	if (thread_id==-1) thread_id = profile.threads_count++;
+	profile.current().events.push_back({scope.name,scope.begin,t,int(cpu_stack.size()),thread_id});
+	addTotal(profile,profile.current().events.back());
+}
+
+void Profiler::beginGpu(const char *name) {
+	Profile &profile = getProfile();
+	GpuPass pass{name,int(profile.gpu_stack.size()),{0,0}}; // no queries if disabled
+	if (profile.enabled) {
+		pass.queries[0] = newQuery(profile); pass.queries[1] = newQuery(profile);
+		glQueryCounter(pass.queries[0],GL_TIMESTAMP);
+	}
+	profile.gpu_stack.push_back(profile.gpu_passes.size());
+	profile.gpu_passes.push_back(pass);
+}
+
+void Profiler::endGpu() {
+	Profile &profile = getProfile();
+	cg_assert(not profile.gpu_stack.empty(),"Profiler::endGpu without beginGpu");
+	const GpuPass &pass = profile.gpu_passes[profile.gpu_stack.back()];
+	profile.gpu_stack.pop_back();
+	if (pass.queries[1]) glQueryCounter(pass.queries[1],GL_TIMESTAMP);
+}
+
+void Profiler::setEnabled(bool enabled) {
+	getProfile().enabled = enabled;
+}
+
+bool Profiler::isEnabled() {
+	return getProfile().enabled;
+}
+
+void Profiler::drawImGui() {
+	if (not ImGui::CollapsingHeader("Profiler")) return;
+	Profile &profile = getProfile();
+	bool enabled = profile.enabled;
+	if (ImGui::Checkbox("Record",&enabled)) profile.enabled = enabled;
+	ImGui::SameLine();
+	if (ImGui::Button("Export trace"))
+		profile.export_status = exportTrace("profile.json") ? "saved profile.json" : "could not write profile.json";
+	if (not profile.export_status.empty()) {
+		ImGui::SameLine();
+		ImGui::TextUnformatted(profile.export_status.c_str());
+	}
+
+	std::lock_guard<std::mutex> lock(profile.mutex);
+	// the duration of the frames in the ring, from the oldest one
+	std::vector<float> times;
+	for(long n=std::max(0L,profile.frame_number-frames_count+1);n<profile.frame_number;++n)
+		if (const Frame *f = profile.find(n)) times.push_back(float(f->end-f->begin)*1000.f);
+	if (not times.empty()) {
+		char overlay[32];
+		snprintf(overlay,sizeof(overlay),"%.2f ms",times.back());
+		ImGui::PlotLines("##frames",times.data(),times.size(),0,overlay,0.f,FLT_MAX,ImVec2(ImGui::GetContentRegionAvail().x,40));
+	}
+
+	const Frame *f = lastComplete(profile);
+	if (not f) return;
+	// the rows: one for each thread and depth (the main thread first, as it
+	// is the first to record), and the GPU at the end
+	std::map<std::pair<int,int>,int> rows;
+	double end = f->end;
+	for(const Event &e : f->events) {
+		rows[{e.thread==-1 ? INT_MAX : e.thread,e.depth}] = 0;
+		end = std::max(end,e.end);
+	}
+	int row_count = 0;
+	for(auto &r : rows) r.second = row_count++;
+	ImGui::Text("Frame %li: %.2f ms CPU, %.2f ms with the GPU",f->number,(f->end-f->begin)*1000.0,(end-f->begin)*1000.0);
+	const float row_height = ImGui::GetTextLineHeight()+4.f;
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImVec2 size(ImGui::GetContentRegionAvail().x,row_height*std::max(1,row_count));
+	ImGui::InvisibleButton("##timeline",size);
+	ImDrawList *draw_list = ImGui::GetWindowDrawList();
+	draw_list->AddRectFilled(origin,ImVec2(origin.x+size.x,origin.y+size.y),IM_COL32(40,40,40,255));
+	float scale = size.x/float(std::max(end-f->begin,1e-6));
+	for(const Event &e : f->events) {
+		int row = rows[{e.thread==-1 ? INT_MAX : e.thread,e.depth}];
+		ImVec2 a(origin.x+float(e.begin-f->begin)*scale,origin.y+row*row_height);
+		ImVec2 b(std::max(a.x+1.f,origin.x+float(e.end-f->begin)*scale),a.y+row_height-1.f);
+		draw_list->AddRectFilled(a,b,colorFor(e.name));
+		if (ImGui::CalcTextSize(e.name).x+4.f<b.x-a.x) {
+			draw_list->PushClipRect(a,b,true);
+			draw_list->AddText(ImVec2(a.x+2.f,a.y+2.f),IM_COL32(255,255,255,255),e.name);
+			draw_list->PopClipRect();
+		}
+		if (ImGui::IsMouseHoveringRect(a,b))
+			ImGui::SetTooltip("%s%s: %.3f ms",e.thread==-1?"GPU ":"",e.name,(e.end-e.begin)*1000.0);
+	}
+}
+
+std::vector<Profiler::Total> Profiler::getTotals() {
+	Profile &profile = getProfile();
+	collectGpu(profile,true);
+	std::lock_guard<std::mutex> lock(profile.mutex);
+	// the same name can be in different literals (with different pointers)
+	std::map<std::pair<std::string,bool>,Total> by_name;
+	for(const auto &t : profile.totals) {
+		Total &total = by_name[{t.first.first,t.first.second}];
+		total.name = t.first.first; total.gpu = t.first.second;
+		total.seconds += t.second.first; total.count += t.second.second;
+	}
+	std::vector<Total> v;
+	for(const auto &t : by_name) v.push_back(t.second);
+	return v;
+}
+
+bool Profiler::exportTrace(const std::string &fname) {
+	std::ofstream out(fname);
+	if (not out) return false;
+	Profile &profile = getProfile();
+	std::lock_guard<std::mutex> lock(profile.mutex);
+	// complete events ("X"), in microseconds; a track per thread, and one for
+	// the GPU; the frames in the first one, as the parents of its scopes
+	const int gpu_tid = 1000;
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpu_tid << ",\"args\":{\"name\":\"GPU\"}}";
+	for(long n=std::max(0L,profile.frame_number-frames_count+1);n<profile.frame_number;++n) {
+		const Frame *f = profile.find(n);
+		if (not f) continue;
+		out << ",\n{\"name\":\"frame " << f->number << "\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":"
+			<< f->begin*1e6 << ",\"dur\":" << (f->end-f->begin)*1e6 << "}";
+		for(const Event &e : f->events) {
+			out << ",\n{\"name\":";
+			writeJsonString(out,e.name);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e.thread==-1 ? gpu_tid : e.thread)
+				<< ",\"ts\":" << e.begin*1e6 << ",\"dur\":" << (e.end-e.begin)*1e6 << "}";
+		}
+	}
+	out << "\n]}\n";
+	return bool(out);
+}
+
@@ -10,6 +10,8 @@
 #include "Renderer.hpp"
 #include "ScreenCapture.hpp"
 #include "RasterAlgs.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20220909.1
 
@@ -62,11 +64,17 @@ void zoomMouseMoveCallback(GLFWwindow* window, double xpos, double ypos);
 void zoomMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void zoomScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
+// entradas simuladas para el modo benchmark
+void benchmarkInput(int frame);
+
 std::vector<glm::vec2> fragments;
 void paintPixel(glm::vec2 p) { fragments.push_back(p); }
 curveRetVal evalCurve(float t) { curveRetVal ret; ret.p = curve.at(t,ret.d); return ret; }
 
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" corre un benchmark sin ventanas visibles (ver Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize main window and setup callbacks
 	main_win.ptr = Window(main_win.width+zoom_win.width,main_win.height,"Area de trabajo",0);
@@ -107,6 +115,11 @@ int main() {
 	// main loop
 	do {
 		
+		// (solo tiempos de cpu, las queries de gpu del Profiler no se comparten 
+		// entre los contextos de las dos ventanas)
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(Benchmark::getFrame());
+		
 		// --- main window ---
 		glfwMakeContextCurrent(main_win.ptr);
 		glClearColor(1.f,1.f,1.f,1.f);
@@ -120,19 +133,28 @@ int main() {
 		
 		// rasterized segments
 		fragments.clear();
-		for(size_t i=0;i<segments.size();i+=2)
-			drawSegment(paintPixel,segments[i],segments[i+1]);
+		{
+			PROFILE_SCOPE("drawSegment");
+			for(size_t i=0;i<segments.size();i+=2)
+				drawSegment(paintPixel,segments[i],segments[i+1]);
+		}
 		renderer.drawPoints(fragments,color_segs_int,1);
 		
 		// rasterized lines
 		fragments.clear();
-		drawCurve(paintPixel,evalCurve);
+		{
+			PROFILE_SCOPE("drawCurve");
+			drawCurve(paintPixel,evalCurve);
+		}
 		renderer.drawPoints(fragments,color_curve_int,1);
 		
 		// capturar el contenido de la ventana principal
 		int zw = zoom_win.width/zoom_win.factor+1, 
 			zh = zoom_win.height/zoom_win.factor+1;
-		capture.take(zoom_win.p0.x,zoom_win.p0.y,zw,zh,zoom_win.factor);
+		{
+			PROFILE_SCOPE("capture");
+			capture.take(zoom_win.p0.x,zoom_win.p0.y,zw,zh,zoom_win.factor);
+		}
 		
 		// zoom area
 		// marcar el area del zoom en la ventana principal
@@ -164,7 +186,7 @@ int main() {
 		
 		glfwPollEvents();
 		
-	} while( glfwGetKey(main_win.ptr,GLFW_KEY_ESCAPE)!=GLFW_PRESS and (not glfwWindowShouldClose(main_win.ptr)) and
+	} while( Benchmark::nextFrame() and glfwGetKey(main_win.ptr,GLFW_KEY_ESCAPE)!=GLFW_PRESS and (not glfwWindowShouldClose(main_win.ptr)) and
 	         glfwGetKey(zoom_win.ptr,GLFW_KEY_ESCAPE)!=GLFW_PRESS and (not glfwWindowShouldClose(zoom_win.ptr)) );
 }
 
@@ -227,3 +249,21 @@ void zoomScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 	zoom_win.factor = std::max(3,zoom_win.factor+int(yoffset));
 }
 
+
+// cada 120 cuadros arrastra un punto de control de la curva o un extremo de
+// un segmento (en un crculo alrededor de su posicin, durante 60 cuadros), y
+// cambia el nivel de zoom
+void benchmarkInput(int frame) {
+	static glm::vec2 p0; // el punto arrastrado
+	int k = frame/120, f = frame%120;
+	if (f==0) {
+		current_selection = k%2 ? &segments[k/2%segments.size()] : &curve[k/2%4];
+		p0 = *current_selection;
+	}
+	if (f<60) {
+		float ang = f*2*3.14159265f/60, r = 40.f;
+		mainMouseMoveCallback(main_win.ptr,p0.x+r*std::sin(ang),main_win.height-(p0.y+r*(1-std::cos(ang))));
+	} else if (f==60) 
+		current_selection = nullptr;
+	if (f==90) zoomScrollCallback(zoom_win.ptr,0,k%4<2?1:-1);
+}
@@ -0,0 +1,11 @@
+// per-frame data shared by all the programs (see FrameData in Shaders.hpp):
+// camera matrixes and light, in a std140 uniform block that the application
+// updates once per frame instead of setting them in each shader for each draw
+
+layout(std140) uniform FrameData {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec4 lightPosition;
+	vec3 lightColor;
+	float ambientStrength;
+};
@@ -5,24 +5,20 @@ in vec3 fragPosition;
 in vec4 lightVSPosition;
 
 // propiedades del material
-uniform vec3 ambientColor;
-uniform vec3 specularColor;
-uniform vec3 diffuseColor;
-uniform vec3 emissionColor;
-uniform float opacity;
-uniform float shininess;
+#include "funcs/materials.glsl"
 
 // propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+#include "funcs/frameData.glsl"
 
 out vec4 fragColor;
 
 #include "funcs/calcPhong.frag"
 
 void main() {
+	MaterialData material = materials[materialIndex];
 	
 	vec3 phong = calcPhong(lightVSPosition, lightColor,
-						   ambientColor, diffuseColor, specularColor, shininess);
-	fragColor = vec4(phong+emissionColor,opacity);
+						   material.ambientColor, material.diffuseColor,
+						   material.specularColor, material.shininess);
+	fragColor = vec4(phong+material.emissionColor,material.opacity);
 }
@@ -4,19 +4,21 @@ in vec3 vertexPosition;
 in vec3 vertexNormal;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 lightPosition;
+#include "funcs/frameData.glsl"
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec4 lightVSPosition;
 
+#include "funcs/decodeVertex.vert"
+
 void main() {
+	vec3 position = decodePosition(vertexPosition);
+	vec3 normal = decodeNormal(vertexNormal);
 	mat4 vm = viewMatrix * modelMatrix;
-	vec4 vmp = vm * vec4(vertexPosition,1.f);
+	vec4 vmp = vm * vec4(position,1.f);
 	fragPosition = vec3(vmp);
 	gl_Position = projectionMatrix * vmp;
-	fragNormal = mat3(transpose(inverse(vm))) * vertexNormal;
+	fragNormal = mat3(transpose(inverse(vm))) * normal;
 	lightVSPosition = vm * lightPosition;
 }
@@ -7,26 +7,22 @@ in vec4 lightVSPosition;
 
 // propiedades del material
 uniform sampler2D colorTexture; // ambient and diffuse components
-uniform vec3 ambientColor;
-uniform vec3 diffuseColor;
-uniform vec3 specularColor;
-uniform float shininess;
-uniform float opacity;
+#include "funcs/materials.glsl"
 
 // propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+#include "funcs/frameData.glsl"
 
 out vec4 fragColor;
 
 #include "funcs/calcPhong.frag"
 
 void main() {
+	MaterialData material = materials[materialIndex];
 	vec4 tex = texture(colorTexture,fragTexCoords);
 	vec3 phong = calcPhong(lightVSPosition, lightColor,
-						   mix(ambientColor,ambientColor*vec3(tex),1.f),
-						   mix(diffuseColor,diffuseColor*vec3(tex),1.f),
-						   specularColor, shininess);
-	fragColor = vec4(phong,opacity);
+						   mix(material.ambientColor,material.ambientColor*vec3(tex),1.f),
+						   mix(material.diffuseColor,material.diffuseColor*vec3(tex),1.f),
+						   material.specularColor, material.shininess);
+	fragColor = vec4(phong,material.opacity);
 }
 
@@ -4,13 +4,16 @@ in vec3 vertexPosition;
 in vec3 vertexNormal;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "funcs/frameData.glsl"
 
 out float colorDecay;
 
+#include "funcs/decodeVertex.vert"
+
 void main() {
-	vec3 fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * vertexNormal;
+	vec3 position = decodePosition(vertexPosition);
+	vec3 normal = decodeNormal(vertexNormal);
+	vec3 fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * normal;
 	colorDecay = fragNormal.z<0.f ? .75f : 1.f;
-	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position,1.f);
 }
@@ -1,7 +1,9 @@
 #ifndef BEZIER_HPP
 #define BEZIER_HPP
+#include <algorithm>
 #include <initializer_list>
 #include <iterator>
+#include <vector>
 #include <glm/glm.hpp>
 #include "Debug.hpp"
 
@@ -22,6 +24,101 @@ VEC Decast(const VEC p[], float t) {
 	return DecastImpl<VEC,D>::eval(p,t);
 }
 
+// binomial coefficients (N k), computed at compile time
+template<int N>
+struct Binomials {
+	float c[N+1];
+	constexpr Binomials() : c() {
+		c[0] = 1.f;
+		for(int k=1;k<=N;++k) c[k] = c[k-1]*(N-k+1)/k;
+	}
+};
+
+// the curve as a sum of Bernstein polynomials, (D i) t^i (1-t)^(D-i) p[i],
+// evaluated as a polynomial in 1-t (with Horner) whose coefficients include
+// the powers of t; the loops have constant bounds, so the compiler unrolls
+// them, and it takes O(D) operations instead of the O(2^D) of Decast
+template<typename VEC, int D>
+VEC Bernstein(const VEC p[], float t) {
+	constexpr Binomials<D> binom;
+	float s = 1-t, tn = 1.f;
+	VEC r = p[0];
+	for(int i=1;i<=D;++i) {
+		tn *= t;
+		r = r*s + p[i]*(binom.c[i]*tn);
+	}
+	return r;
+}
+
+// same, and its derivative: D times the curve of degree D-1 with the
+// differences p[i+1]-p[i] (evaluated in the same loop)
+template<typename VEC, int D>
+VEC Bernstein(const VEC p[], float t, VEC &deriv) {
+	constexpr Binomials<D> binom;
+	constexpr Binomials<D-1> dbinom;
+	float s = 1-t, tn = 1.f;
+	VEC r = p[0], dr = p[1]-p[0];
+	for(int i=1;i<D;++i) {
+		tn *= t;
+		r = r*s + p[i]*(binom.c[i]*tn);
+		dr = dr*s + (p[i+1]-p[i])*(dbinom.c[i]*tn);
+	}
+	r = r*s + p[D]*(tn*t);
+	deriv = dr*float(D);
+	return r;
+}
+
+// an upper bound of the distance from the curve to its chord p[0]-p[D]: the
+// curve is inside the convex hull of its control points, so it is never
+// farther from the chord than they are; the distances are measured after
+// applying to_screen to the points (so the bound can be in pixels)
+template<typename VEC, int D, typename F>
+float ChordDistance(const VEC p[], const F &to_screen) {
+	auto a = to_screen(p[0]), ab = to_screen(p[D])-a;
+	float len2 = glm::dot(ab,ab), err = 0.f;
+	for(int i=1;i<D;++i) {
+		auto ap = to_screen(p[i])-a;
+		float s = len2>0.f ? glm::clamp(glm::dot(ap,ab)/len2,0.f,1.f) : 0.f;
+		err = std::max(err,glm::length(ap-ab*s));
+	}
+	return err;
+}
+
+// the control points of both halves of the curve (de Casteljau at t=.5)
+template<typename VEC, int D>
+void SplitHalf(const VEC p[], VEC left[], VEC right[]) {
+	VEC q[D+1];
+	for(int i=0;i<=D;++i) q[i] = p[i];
+	for(int k=D;k>=0;--k) { // q has k+1 points
+		left[D-k] = q[0]; right[k] = q[k];
+		for(int i=0;i<k;++i) q[i] = (q[i]+q[i+1])*.5f;
+	}
+}
+
+// appends to out the vertexes (but the first one) of a polyline within
+// tolerance of the curve: while the ChordDistance bound is above tolerance
+// the curve is split in halves, at most max_depth times
+template<typename VEC, int D, typename F>
+void Flatten(const VEC p[], float tolerance, const F &to_screen, int max_depth, std::vector<VEC> &out) {
+	if (ChordDistance<VEC,D>(p,to_screen)<=tolerance or max_depth==0) { out.push_back(p[D]); return; }
+	VEC left[D+1], right[D+1];
+	SplitHalf<VEC,D>(p,left,right);
+	Flatten<VEC,D>(left,tolerance,to_screen,max_depth-1,out);
+	Flatten<VEC,D>(right,tolerance,to_screen,max_depth-1,out);
+}
+
+// the number of halvings in the deepest branch of Flatten (same arguments):
+// 2^depth uniform segments in t put every segment inside one of the pieces
+// Flatten would produce (for drawing the curve with uniform values of t)
+template<typename VEC, int D, typename F>
+int FlattenDepth(const VEC p[], float tolerance, const F &to_screen, int max_depth) {
+	if (ChordDistance<VEC,D>(p,to_screen)<=tolerance or max_depth==0) return 0;
+	VEC left[D+1], right[D+1];
+	SplitHalf<VEC,D>(p,left,right);
+	return 1+std::max(FlattenDepth<VEC,D>(left,tolerance,to_screen,max_depth-1),
+	                  FlattenDepth<VEC,D>(right,tolerance,to_screen,max_depth-1));
+}
+
 template<typename VEC = glm::vec3, int DEGREE=3>
 class Bezier {
 	VEC p[DEGREE+1];
@@ -35,12 +132,55 @@ public:
 	VEC &operator[](int i) { return p[i]; }
 	const VEC &operator[](int i) const { return p[i]; }
 	VEC at(float t) const {
-		return Decast<VEC,DEGREE>(p,t);
+		return Bernstein<VEC,DEGREE>(p,t);
 	}
 	VEC at(float t, VEC &deriv) const {
-		VEC x[2] = { Decast<VEC,DEGREE-1>(p,t), Decast<VEC,DEGREE-1>(p+1,t) };
-		deriv = (x[1]-x[0])*float(DEGREE);
-		return Decast<VEC,1>(x,t);
+		return Bernstein<VEC,DEGREE>(p,t,deriv);
+	}
+	// evaluates the curve (and its derivative, if derivs is not null) at the n
+	// values of ts; the curve is converted once to the power basis, and each
+	// sample is then a Horner evaluation (D multiply-adds), independent from
+	// the others so the loop can be pipelined/vectorized
+	void evalMany(const float *ts, int n, VEC *out, VEC *derivs=nullptr) const {
+		VEC a[DEGREE+1], d[DEGREE+1]; // coefficients of t^k, and differences of p
+		constexpr Binomials<DEGREE> binom;
+		for(int i=0;i<=DEGREE;++i) d[i] = p[i];
+		for(int k=0;k<=DEGREE;++k) {
+			a[k] = d[0]*binom.c[k]; // (D k) times the k-th difference of p[0]
+			for(int i=0;i<DEGREE-k;++i) d[i] = d[i+1]-d[i];
+		}
+		for(int j=0;j<n;++j) {
+			float t = ts[j];
+			VEC r = a[DEGREE];
+			for(int k=DEGREE-1;k>=0;--k) r = r*t+a[k];
+			out[j] = r;
+		}
+		if (derivs) {
+			for(int k=0;k<DEGREE;++k) d[k] = a[k+1]*float(k+1);
+			for(int j=0;j<n;++j) {
+				float t = ts[j];
+				VEC r = d[DEGREE-1];
+				for(int k=DEGREE-2;k>=0;--k) r = r*t+d[k];
+				derivs[j] = r;
+			}
+		}
+	}
+	// the curve as a polyline within tolerance of it (see Flatten); the points
+	// are appended to out, and the first one only if out is empty (so the
+	// pieces of a spline can be appended one after the other)
+	template<typename F>
+	void flatten(float tolerance, std::vector<VEC> &out, const F &to_screen, int max_depth=16) const {
+		if (out.empty()) out.push_back(p[0]);
+		Flatten<VEC,DEGREE>(p,tolerance,to_screen,max_depth,out);
+	}
+	void flatten(float tolerance, std::vector<VEC> &out) const {
+		flatten(tolerance,out,[](const VEC &v) { return v; });
+	}
+	// the number of uniform segments in t (a power of 2) that draw the curve
+	// within tolerance (see FlattenDepth)
+	template<typename F>
+	int segmentsCount(float tolerance, const F &to_screen, int max_depth=16) const {
+		return 1<<FlattenDepth<VEC,DEGREE>(p,tolerance,to_screen,max_depth);
 	}
 	int degree() const { return DEGREE; }
 	VEC *data() { return p; }
@@ -1,22 +1,48 @@
+#include <algorithm>
 #include "BezierRenderer.hpp"
 #include "Debug.hpp"
 
 BezierRenderer::BezierRenderer(int nsamples) : shader("shaders/curve") { 
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	loc_pos = shader.getAttribute("vertexPosition");
+	cg_assert(loc_pos.isOk(),"Shader does not have vertexPosition attribute");
+	loc_color = shader.getUniform<glm::vec3>("color");
 	
 	v_curve.resize(nsamples);
+	t_curve.resize(nsamples);
+	for(int i=0;i<nsamples;++i)
+		t_curve[i] = float(i)/(nsamples-1);
 	v_poly.resize(4);
+	glGenVertexArrays(2, VAO);
 	glGenBuffers(2, VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, v_curve.size() * sizeof(glm::vec3), v_curve.data(), GL_DYNAMIC_DRAW);  
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, 4*sizeof(glm::vec3), v_poly.data(), GL_DYNAMIC_DRAW);  
+	// one VAO per buffer, configured only once
+	for(int i=0;i<2;++i) {
+		glBindVertexArray(VAO[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO[i]);
+		const std::vector<glm::vec3> &v = i==0 ? v_curve : v_poly;
+		glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(glm::vec3), v.data(), GL_DYNAMIC_DRAW);  
+		glVertexAttribPointer(loc_pos.location, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(loc_pos.location);
+	}
+	curve_capacity = v_curve.size();
 }
 
 BezierRenderer::~BezierRenderer() {
 	glDeleteBuffers(2,VBO);
-	glDeleteVertexArrays(1,&VAO);
+	glDeleteVertexArrays(2,VAO);
+	glDeleteBuffers(2,pieces_VBO);
+	glDeleteVertexArrays(1,&pieces_VAO);
+}
+
+void BezierRenderer::uploadBuffers() {
+	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
+	// the adaptive polylines may not fit in the buffer
+	if (v_curve.size()>curve_capacity) {
+		curve_capacity = v_curve.size();
+		glBufferData(GL_ARRAY_BUFFER, curve_capacity * sizeof(glm::vec3), v_curve.data(), GL_DYNAMIC_DRAW);
+	} else
+		glBufferSubData(GL_ARRAY_BUFFER, 0, v_curve.size() * sizeof(glm::vec3), v_curve.data());
+	glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, v_poly.size() * sizeof(glm::vec3), v_poly.data());
 }
 
 Shader &BezierRenderer::getShader() {
@@ -25,27 +51,80 @@ Shader &BezierRenderer::getShader() {
 }
 
 void BezierRenderer::drawPoly() {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
-	GLint loc_pos = glGetAttribLocation(shader.getProgramId(), "vertexPosition"); 
-	cg_assert(loc_pos!=-1,"Shader does not have vertexPosition attribute");
-	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(loc_pos);
-	shader.setUniform("color",color_poly);
+	glBindVertexArray(VAO[1]);
+	shader.setUniform(loc_color,color_poly);
 	glDrawArrays(GL_LINES, 0,v_poly.size());
-	shader.setUniform("color",color_points);
+	shader.setUniform(loc_color,color_points);
 	glDrawArrays(GL_POINTS, 0,v_poly.size());
-	glBindVertexArray(0);
 }
 
 void BezierRenderer::drawCurve() {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
-	GLint loc_pos = glGetAttribLocation(shader.getProgramId(), "vertexPosition"); 
-	cg_assert(loc_pos!=-1,"Shader does not have vertexPosition attribute");
-	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(loc_pos);
-	shader.setUniform("color",color_curve);
-	glDrawArrays(GL_POINTS, 0,v_curve.size());
-	glBindVertexArray(0);
+	glBindVertexArray(VAO[0]);
+	shader.setUniform(loc_color,color_curve);
+	glDrawArrays(GL_LINE_STRIP, 0,v_curve.size());
+}
+
+void BezierRenderer::loadPiecesShader() {
+	if (pieces_shader.getProgramId()) return;
+	pieces_shader.load("shaders/curveInstanced.vert","shaders/curve.frag");
+	loc_pieces_color = pieces_shader.getUniform<glm::vec3>("color");
+	loc_pieces_poly = pieces_shader.getUniform<int>("controlPolygon");
+	// the control points and the segments are per-instance attributes
+	glGenVertexArrays(1, &pieces_VAO);
+	glGenBuffers(2, pieces_VBO);
+	glBindVertexArray(pieces_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, pieces_VBO[0]);
+	const char *names[] = { "p0", "p1", "p2", "p3" };
+	for(int i=0;i<4;++i) {
+		Shader::Attribute loc = pieces_shader.getAttribute(names[i]);
+		cg_assert(loc.isOk(),std::string("Shader does not have ")+names[i]+" attribute");
+		glVertexAttribPointer(loc.location, 3, GL_FLOAT, GL_FALSE, 4*sizeof(glm::vec3), (void*)(i*sizeof(glm::vec3)));
+		glVertexAttribDivisor(loc.location, 1);
+		glEnableVertexAttribArray(loc.location);
+	}
+	Shader::Attribute loc_segments = pieces_shader.getAttribute("segments");
+	cg_assert(loc_segments.isOk(),"Shader does not have segments attribute");
+	glBindBuffer(GL_ARRAY_BUFFER, pieces_VBO[1]);
+	glVertexAttribIPointer(loc_segments.location, 1, GL_INT, 0, 0);
+	glVertexAttribDivisor(loc_segments.location, 1);
+	glEnableVertexAttribArray(loc_segments.location);
+}
+
+int BezierRenderer::segmentsDepth() const {
+	int depth = 0;
+	while ((2<<depth)<=int(t_curve.size())-1) ++depth;
+	return depth;
+}
+
+Shader &BezierRenderer::getPiecesShader() {
+	loadPiecesShader();
+	pieces_shader.use();
+	return pieces_shader;
+}
+
+void BezierRenderer::uploadPieces() {
+	loadPiecesShader();
+	glBindBuffer(GL_ARRAY_BUFFER, pieces_VBO[0]);
+	glBufferData(GL_ARRAY_BUFFER, v_pieces.size() * sizeof(glm::vec3), v_pieces.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, pieces_VBO[1]);
+	glBufferData(GL_ARRAY_BUFFER, s_pieces.size() * sizeof(GLint), s_pieces.data(), GL_DYNAMIC_DRAW);
+	max_segments = s_pieces.empty() ? 0 : *std::max_element(s_pieces.begin(),s_pieces.end());
+}
+
+void BezierRenderer::drawPieces(GLenum mode, int count, bool poly, const glm::vec3 &color) {
+	glBindVertexArray(pieces_VAO);
+	pieces_shader.setUniform(loc_pieces_color,color);
+	pieces_shader.setUniform(loc_pieces_poly,poly?1:0);
+	glDrawArraysInstanced(mode, 0, count, v_pieces.size()/4);
+}
+
+void BezierRenderer::drawPiecesPoly(bool full) {
+	drawPieces(full?GL_LINE_STRIP:GL_LINES,4,true,color_poly);
+	drawPieces(GL_POINTS,4,true,color_points);
+}
+
+// every instance draws max_segments+1 vertexes, the shader repeats the last
+// one of the pieces with less segments
+void BezierRenderer::drawPiecesCurve() {
+	drawPieces(GL_LINE_STRIP,max_segments+1,false,color_curve);
 }
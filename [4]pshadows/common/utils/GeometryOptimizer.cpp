@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "GeometryOptimizer.hpp"
+
+namespace {
+
+// FIFO cache simulation: a vertex is in the cache if less than cache_size
+// vertexes were transformed since its own transformation
+struct FifoCache {
+	std::vector<unsigned> time;
+	unsigned now, size;
+	FifoCache(size_t nverts, int cache_size) : time(nverts,0), now(cache_size+1), size(cache_size) { }
+	bool miss(int v) {
+		if (now-time[v]<=size) return false;
+		time[v] = now++;
+		return true;
+	}
+	void reset() { now += size+1; }
+};
+
+// --- Forsyth ---
+
+const int forsyth_cache_size = 32;
+
+float vertexScore(int cache_pos, int remaining_tris) {
+	if (remaining_tris==0) return -1.f;
+	float score = 0.f;
+	if (cache_pos>=0) {
+		if (cache_pos<3) // the last triangle's vertexes, a bit lower to avoid strips
+			score = 0.75f;
+		else
+			score = std::pow(1.f-(cache_pos-3)/float(forsyth_cache_size-3),1.5f);
+	}
+	// boost vertexes with few triangles left, so they are not left alone
+	return score + 2.f/std::sqrt(float(remaining_tris));
+}
+
+template<typename T>
+void applyRemap(std::vector<T> &v, const std::vector<int> &remap) {
+	if (v.size()!=remap.size()) return;
+	std::vector<T> aux(v.size());
+	for(size_t i=0;i<v.size();++i) aux[remap[i]] = v[i];
+	v.swap(aux);
+}
+
+}
+
+VertexCacheStats analyzeVertexCache(const Geometry &geo, int cache_size) {
+	VertexCacheStats stats;
+	if (geo.triangles.empty() or geo.positions.empty()) return stats;
+	FifoCache cache(geo.positions.size(),cache_size);
+	size_t misses = 0;
+	for(int v : geo.triangles)
+		if (cache.miss(v)) ++misses;
+	stats.acmr = float(misses)/(geo.triangles.size()/3);
+	stats.atvr = float(misses)/geo.positions.size();
+	return stats;
+}
+
+void optimizeVertexCache(Geometry &geo) {
+	const std::vector<int> &tris = geo.triangles;
+	size_t ntris = tris.size()/3, nverts = geo.positions.size();
+	if (ntris==0) return;
+
+	// triangles that use each vertex (the first remaining[v] in its range
+	// are the ones not emitted yet)
+	std::vector<int> remaining(nverts,0), offsets(nverts+1,0), adjacency(tris.size());
+	for(int v : tris) ++remaining[v];
+	for(size_t v=0;v<nverts;++v) offsets[v+1] = offsets[v]+remaining[v];
+	{
+		std::vector<int> next(offsets.begin(),offsets.end()-1);
+		for(size_t t=0;t<ntris;++t)
+			for(int k=0;k<3;++k)
+				adjacency[next[tris[3*t+k]]++] = t;
+	}
+
+	std::vector<int> cache_pos(nverts,-1);
+	std::vector<float> vscore(nverts), tscore(ntris,0.f);
+	for(size_t v=0;v<nverts;++v)
+		vscore[v] = vertexScore(-1,remaining[v]);
+	for(size_t t=0;t<ntris;++t)
+		for(int k=0;k<3;++k)
+			tscore[t] += vscore[tris[3*t+k]];
+	std::vector<char> emitted(ntris,false);
+
+	std::vector<int> result; result.reserve(tris.size());
+	std::vector<int> cache, new_cache;
+	int best = std::max_element(tscore.begin(),tscore.end())-tscore.begin();
+	size_t next_unemitted = 0;
+
+	auto updateScore = [&](int v, int pos) {
+		float score = vertexScore(pos,remaining[v]);
+		float diff = score-vscore[v];
+		vscore[v] = score;
+		for(int i=offsets[v];i<offsets[v]+remaining[v];++i)
+			tscore[adjacency[i]] += diff;
+	};
+
+	while (result.size()<tris.size()) {
+		if (best==-1) { // nothing good in the cache, just take any triangle
+			while (emitted[next_unemitted]) ++next_unemitted;
+			best = next_unemitted;
+		}
+		emitted[best] = true;
+
+		new_cache.clear();
+		for(int k=0;k<3;++k) {
+			int v = tris[3*best+k];
+			result.push_back(v);
+			if (std::find(new_cache.begin(),new_cache.end(),v)==new_cache.end())
+				new_cache.push_back(v);
+			int *adj = &adjacency[offsets[v]], &n = remaining[v];
+			for(int j=0;j<n;++j) {
+				if (adj[j]==best) { std::swap(adj[j],adj[n-1]); --n; break; }
+			}
+		}
+		for(int v : cache)
+			if (std::find(new_cache.begin(),new_cache.end(),v)==new_cache.end())
+				new_cache.push_back(v);
+
+		// vertexes pushed out of the cache
+		for(size_t i=forsyth_cache_size;i<new_cache.size();++i) {
+			cache_pos[new_cache[i]] = -1;
+			updateScore(new_cache[i],-1);
+		}
+		if (new_cache.size()>size_t(forsyth_cache_size))
+			new_cache.resize(forsyth_cache_size);
+		cache.swap(new_cache);
+
+		for(size_t i=0;i<cache.size();++i) {
+			cache_pos[cache[i]] = i;
+			updateScore(cache[i],i);
+		}
+
+		// next triangle: the best one among those using cached vertexes
+		best = -1; float best_score = -1.f;
+		for(int v : cache) {
+			for(int i=offsets[v];i<offsets[v]+remaining[v];++i) {
+				int t = adjacency[i];
+				if (tscore[t]>best_score) { best = t; best_score = tscore[t]; }
+			}
+		}
+	}
+	geo.triangles.swap(result);
+}
+
+void optimizeOverdraw(Geometry &geo, float threshold) {
+	const std::vector<int> &tris = geo.triangles;
+	size_t ntris = tris.size()/3;
+	if (ntris<2) return;
+
+	// hard boundaries: triangles that miss all of their vertexes (the cache
+	// is useless there, so starting a new cluster costs nothing)
+	std::vector<size_t> hard;
+	FifoCache cache(geo.positions.size(),16);
+	for(size_t t=0;t<ntris;++t) {
+		int misses = cache.miss(tris[3*t])+cache.miss(tris[3*t+1])+cache.miss(tris[3*t+2]);
+		if (t==0 or misses==3) hard.push_back(t);
+	}
+	hard.push_back(ntris);
+
+	// soft boundaries: split hard clusters where the cache efficiency up to
+	// there is close enough to the efficiency of the whole cluster
+	std::vector<size_t> clusters;
+	for(size_t c=0;c+1<hard.size();++c) {
+		size_t begin = hard[c], end = hard[c+1];
+		cache.reset(); size_t misses = 0;
+		for(size_t i=3*begin;i<3*end;++i) misses += cache.miss(tris[i]);
+		float cluster_acmr = float(misses)/(end-begin);
+
+		clusters.push_back(begin);
+		cache.reset(); misses = 0;
+		for(size_t t=begin, start=begin;t<end;++t) {
+			for(int k=0;k<3;++k) misses += cache.miss(tris[3*t+k]);
+			if (t+1<end and float(misses)/(t+1-start)<=cluster_acmr*threshold) {
+				clusters.push_back(t+1);
+				start = t+1; misses = 0; cache.reset();
+			}
+		}
+	}
+	clusters.push_back(ntris);
+
+	// sort clusters: the ones facing away from the mesh center first
+	std::vector<glm::vec3> cluster_center(clusters.size()-1), cluster_normal(clusters.size()-1);
+	std::vector<float> cluster_area(clusters.size()-1,0.f);
+	glm::vec3 mesh_center(0.f); float mesh_area = 0.f;
+	for(size_t c=0;c+1<clusters.size();++c) {
+		glm::vec3 center(0.f), normal(0.f); float area = 0.f;
+		for(size_t t=clusters[c];t<clusters[c+1];++t) {
+			const glm::vec3 &p0 = geo.positions[tris[3*t]], &p1 = geo.positions[tris[3*t+1]], &p2 = geo.positions[tris[3*t+2]];
+			glm::vec3 n = glm::cross(p1-p0,p2-p0);
+			float a = glm::length(n);
+			center += (p0+p1+p2)*(a/3.f);
+			normal += n;
+			area += a;
+		}
+		cluster_center[c] = area>0 ? center/area : geo.positions[tris[3*clusters[c]]];
+		cluster_normal[c] = glm::dot(normal,normal)>0 ? glm::normalize(normal) : normal;
+		mesh_center += center; mesh_area += area;
+	}
+	if (mesh_area>0) mesh_center /= mesh_area;
+
+	std::vector<float> sort_key(clusters.size()-1);
+	std::vector<int> order(clusters.size()-1);
+	for(size_t c=0;c<order.size();++c) {
+		order[c] = c;
+		sort_key[c] = glm::dot(cluster_center[c]-mesh_center,cluster_normal[c]);
+	}
+	std::stable_sort(order.begin(),order.end(),[&](int a, int b) {
+		return sort_key[a]>sort_key[b];
+	});
+
+	std::vector<int> result; result.reserve(tris.size());
+	for(int c : order)
+		result.insert(result.end(),tris.begin()+3*clusters[c],tris.begin()+3*clusters[c+1]);
+	geo.triangles.swap(result);
+}
+
+void optimizeVertexFetch(Geometry &geo) {
+	if (geo.triangles.empty()) return;
+	std::vector<int> remap(geo.positions.size(),-1);
+	int next = 0;
+	for(int &v : geo.triangles) {
+		if (remap[v]==-1) remap[v] = next++;
+		v = remap[v];
+	}
+	for(int &r : remap) // unused vertexes go to the end
+		if (r==-1) r = next++;
+	applyRemap(geo.positions,remap);
+	applyRemap(geo.normals,remap);
+	applyRemap(geo.tex_coords,remap);
+}
+
+void optimizeGeometry(Geometry &geo) {
+	optimizeVertexCache(geo);
+	optimizeOverdraw(geo);
+	optimizeVertexFetch(geo);
+}
+
@@ -3,15 +3,45 @@
 #include <string>
 #include <utility>
 #include <vector>
+#include <thread>
+#include <algorithm>
 #include <glm/glm.hpp>
 
 std::string extractFolder(const std::string &filename);
 
 void fixEOL(std::string &s);
 
-bool startsWith(const std::string str, const char *con);
+bool startsWith(const std::string &str, const char *con);
 
 std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v);
 
+// modification time and size of a file (false if it does not exist)
+bool getFileStamp(const std::string &filename, long long &mtime, long long &size);
+
+// creates the folder (only the last level), true if it exists afterwards
+bool createFolder(const std::string &path);
+
+// a name for a new temporary file next to path (unique among processes)
+std::string getTempFileName(const std::string &path);
+
+// replaces dst with src (a complete file written with another name), so a
+// reader of dst gets either the old file or the new one, never a partial one;
+// if it fails src is removed
+bool replaceFile(const std::string &src, const std::string &dst);
+
+// calls f(begin,end) for consecutive ranges of [0;n), in parallel (up to one
+// thread per core, but only if each range gets at least min_range elements)
+template<typename F>
+void parallelFor(size_t n, size_t min_range, const F &f) {
+	size_t nthreads = std::max(1u,std::thread::hardware_concurrency());
+	size_t nranges = std::max<size_t>(1,std::min(nthreads,n/std::max<size_t>(min_range,1)));
+	if (nranges==1) { f(size_t(0),n); return; }
+	std::vector<std::thread> workers;
+	for(size_t i=1;i<nranges;++i)
+		workers.emplace_back([&f,n,nranges,i](){ f(n*i/nranges,n*(i+1)/nranges); });
+	f(size_t(0),n/nranges);
+	for(std::thread &t : workers) t.join();
+}
+
 #endif
 
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Simplifier.hpp"
+
+namespace {
+
+// symmetric 4x4 matrix whose quadratic form is the weighted sum of the
+// squared distances to a set of planes (only the upper triangle is stored)
+struct Quadric {
+	double a[10] = {}; // xx xy xz xw yy yz yw zz zw ww
+	double weight = 0;
+	void addPlane(const glm::vec3 &n, float d, float w) {
+		double p[4] = {n.x,n.y,n.z,d};
+		for(int i=0,k=0;i<4;++i)
+			for(int j=i;j<4;++j)
+				a[k++] += w*p[i]*p[j];
+		weight += w;
+	}
+	Quadric &operator+=(const Quadric &q) {
+		for(int i=0;i<10;++i) a[i] += q.a[i];
+		weight += q.weight;
+		return *this;
+	}
+	// mean squared distance
+	double eval(const glm::vec3 &v) const {
+		if (weight==0) return 0;
+		double x = v.x, y = v.y, z = v.z;
+		return std::max(0.0, a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+						   + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+						   + a[7]*z*z + 2*a[8]*z + a[9]) / weight;
+	}
+};
+
+// vertexes with the same position get the same id (the first of them)
+std::vector<int> weldPositions(const std::vector<glm::vec3> &pos) {
+	std::vector<int> order(pos.size());
+	std::iota(order.begin(),order.end(),0);
+	std::sort(order.begin(),order.end(),[&](int a, int b) {
+		const glm::vec3 &p = pos[a], &q = pos[b];
+		if (p.x!=q.x) return p.x<q.x;
+		if (p.y!=q.y) return p.y<q.y;
+		if (p.z!=q.z) return p.z<q.z;
+		return a<b;
+	});
+	std::vector<int> weld(pos.size());
+	for(size_t i=0;i<order.size();++i) {
+		int v = order[i];
+		weld[v] = (i>0 and pos[v]==pos[order[i-1]]) ? weld[order[i-1]] : v;
+	}
+	return weld;
+}
+
+uint64_t edgeKey(int a, int b) {
+	if (a>b) std::swap(a,b);
+	return (uint64_t(a)<<32)|uint32_t(b);
+}
+
+glm::vec3 triangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+	return glm::cross(p1-p0,p2-p0);
+}
+
+struct Collapse {
+	double cost;
+	int from, to;
+};
+
+}
+
+Geometry simplifyGeometry(const Geometry &geo, size_t target_triangles, float *error) {
+	if (error) *error = 0.f;
+	if (geo.triangles.size()/3<=target_triangles) return geo;
+
+	const std::vector<glm::vec3> &pos = geo.positions;
+	size_t nverts = pos.size();
+	std::vector<int> tris = geo.triangles;
+	size_t ntris = tris.size()/3, live = ntris;
+	std::vector<int> weld = weldPositions(pos);
+
+	// locked vertexes (by welded id): seams and borders
+	std::vector<char> locked(nverts,false);
+	{
+		std::vector<int> wedges(nverts,0);
+		for(size_t v=0;v<nverts;++v)
+			if (++wedges[weld[v]]>1) locked[weld[v]] = true;
+		std::vector<uint64_t> edges; edges.reserve(tris.size());
+		for(size_t t=0;t<ntris;++t)
+			for(int k=0;k<3;++k)
+				edges.push_back(edgeKey(weld[tris[3*t+k]],weld[tris[3*t+(k+1)%3]]));
+		std::sort(edges.begin(),edges.end());
+		for(size_t i=0,j;i<edges.size();i=j) {
+			for(j=i+1;j<edges.size() and edges[j]==edges[i];++j);
+			if (j-i==1) locked[edges[i]>>32] = locked[edges[i]&0xFFFFFFFF] = true;
+		}
+	}
+
+	// quadrics (by welded id): planes of the triangles around each vertex,
+	// weighted by their areas
+	std::vector<Quadric> quadrics(nverts);
+	for(size_t t=0;t<ntris;++t) {
+		const glm::vec3 &p0 = pos[tris[3*t]];
+		glm::vec3 n = triangleNormal(p0,pos[tris[3*t+1]],pos[tris[3*t+2]]);
+		float len = glm::length(n);
+		if (len==0.f) continue;
+		n /= len;
+		Quadric q; q.addPlane(n,-glm::dot(n,p0),len*.5f);
+		for(int k=0;k<3;++k) quadrics[weld[tris[3*t+k]]] += q;
+	}
+
+	// a triangle dies when two of its vertexes get the same position
+	std::vector<char> dead(ntris,false);
+	auto isDead = [&](size_t t) {
+		int w0 = weld[tris[3*t]], w1 = weld[tris[3*t+1]], w2 = weld[tris[3*t+2]];
+		return w0==w1 or w1==w2 or w2==w0;
+	};
+	for(size_t t=0;t<ntris;++t)
+		if (isDead(t)) { dead[t] = true; --live; }
+
+	// the collapse from->to is valid if it does not flip any triangle, and if
+	// all the triangles that share the edge use the same vertex for "to" (there
+	// is no seam there)
+	std::vector<int> offsets(nverts+1), adjacency;
+	auto canCollapse = [&](int from, int to) {
+		for(int i=offsets[from];i<offsets[from+1];++i) {
+			int t = adjacency[i];
+			if (dead[t]) continue;
+			int *tri = &tris[3*t];
+			if (weld[tri[0]]==weld[to] or weld[tri[1]]==weld[to] or weld[tri[2]]==weld[to]) {
+				if (tri[0]!=to and tri[1]!=to and tri[2]!=to) return false;
+				continue;
+			}
+			glm::vec3 p[3] = { pos[tri[0]], pos[tri[1]], pos[tri[2]] };
+			glm::vec3 n0 = triangleNormal(p[0],p[1],p[2]);
+			for(int k=0;k<3;++k) if (tri[k]==from) p[k] = pos[to];
+			glm::vec3 n1 = triangleNormal(p[0],p[1],p[2]);
+			if (glm::dot(n0,n1)<=.25f*glm::length(n0)*glm::length(n1)) return false;
+		}
+		return true;
+	};
+
+	// each pass sorts the candidates by cost and applies the cheaper ones that
+	// do not touch vertexes already modified in that same pass
+	std::vector<Collapse> collapses;
+	std::vector<char> touched(nverts);
+	double max_cost = 0.0;
+	while (live>target_triangles) {
+		std::fill(offsets.begin(),offsets.end(),0);
+		for(size_t t=0;t<ntris;++t)
+			if (not dead[t]) for(int k=0;k<3;++k) ++offsets[tris[3*t+k]+1];
+		std::partial_sum(offsets.begin(),offsets.end(),offsets.begin());
+		adjacency.resize(offsets.back());
+		{
+			std::vector<int> next(offsets.begin(),offsets.end()-1);
+			for(size_t t=0;t<ntris;++t)
+				if (not dead[t]) for(int k=0;k<3;++k) adjacency[next[tris[3*t+k]]++] = t;
+		}
+
+		collapses.clear();
+		for(size_t t=0;t<ntris;++t) {
+			if (dead[t]) continue;
+			for(int k=0;k<3;++k) {
+				int a = tris[3*t+k], b = tris[3*t+(k+1)%3];
+				Quadric q = quadrics[weld[a]]; q += quadrics[weld[b]];
+				if (not locked[weld[a]]) collapses.push_back({q.eval(pos[b]),a,b});
+				if (not locked[weld[b]]) collapses.push_back({q.eval(pos[a]),b,a});
+			}
+		}
+		std::sort(collapses.begin(),collapses.end(),[](const Collapse &a, const Collapse &b) {
+			return a.cost<b.cost;
+		});
+
+		// each collapse removes about 2 triangles
+		size_t goal = std::max<size_t>((live-target_triangles)/2,1), done = 0;
+		std::fill(touched.begin(),touched.end(),false);
+		for(const Collapse &c : collapses) {
+			if (done==goal or live<=target_triangles) break;
+			int wfrom = weld[c.from], wto = weld[c.to];
+			if (touched[wfrom] or touched[wto] or not canCollapse(c.from,c.to)) continue;
+			for(int i=offsets[c.from];i<offsets[c.from+1];++i) {
+				int t = adjacency[i];
+				if (dead[t]) continue;
+				for(int k=0;k<3;++k) if (tris[3*t+k]==c.from) tris[3*t+k] = c.to;
+				if (isDead(t)) { dead[t] = true; --live; }
+			}
+			quadrics[wto] += quadrics[wfrom];
+			touched[wfrom] = touched[wto] = true;
+			max_cost = std::max(max_cost,c.cost);
+			++done;
+		}
+		if (done==0) break; // everything left is locked or would flip
+	}
+
+	// only the vertexes still used, in the order of the triangles
+	Geometry result;
+	std::vector<int> remap(nverts,-1);
+	for(size_t t=0;t<ntris;++t) {
+		if (dead[t]) continue;
+		for(int k=0;k<3;++k) {
+			int v = tris[3*t+k];
+			if (remap[v]==-1) {
+				remap[v] = result.positions.size();
+				result.positions.push_back(pos[v]);
+				if (not geo.normals.empty()) result.normals.push_back(geo.normals[v]);
+				if (not geo.tex_coords.empty()) result.tex_coords.push_back(geo.tex_coords[v]);
+			}
+			result.triangles.push_back(remap[v]);
+		}
+	}
+	if (error) *error = static_cast<float>(std::sqrt(max_cost));
+	return result;
+}
+
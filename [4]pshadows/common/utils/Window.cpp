@@ -1,8 +1,12 @@
+#include <cstdlib>
 #include <stdexcept>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 #include "Window.hpp"
 #include "Debug.hpp"
+#include "Benchmark.hpp"
+#include "Profiler.hpp"
+#include "AssetCache.hpp"
 #include <iomanip>
 #include <sstream>
 
@@ -27,6 +31,12 @@ Window::Window (int w, int h, const std::string & title, int flags, GLFWwindow *
 			std::stringstream scode; scode<<"0x"<<std::hex<<code;
 			cg_error("GLFW code "+scode.str()+": "+message); 
 		}); 
+		// benchmarks on a machine without a display use glfw's null platform,
+		// that renders with osmesa (mesa's software rendering)
+#if !defined(_WIN32) && !defined(__APPLE__) && (GLFW_VERSION_MAJOR>3 || (GLFW_VERSION_MAJOR==3 && GLFW_VERSION_MINOR>=4))
+		if (Benchmark::isActive() and not std::getenv("DISPLAY") and not std::getenv("WAYLAND_DISPLAY"))
+			glfwInitHint(GLFW_PLATFORM,GLFW_PLATFORM_NULL);
+#endif
 		if (not glfwInit()) cg_error("Failed to initialize GLFW");
 	}
 	
@@ -34,12 +44,14 @@ Window::Window (int w, int h, const std::string & title, int flags, GLFWwindow *
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT,GL_TRUE); // mac-os bug?
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE,Benchmark::isActive()?GLFW_FALSE:GLFW_TRUE);
 	if (flags&fAntialiasing) glfwWindowHint(GLFW_SAMPLES,4); // antialiasing
 	
 	glfwMakeContextCurrent(nullptr);
 	win_ptr = glfwCreateWindow(w,h,title.c_str(),nullptr,share_context_with);
 	cg_assert(win_ptr,"Failed to create GLFW window");
 	glfwMakeContextCurrent(win_ptr);
+	if (Benchmark::isActive()) glfwSwapInterval(0); // don't wait for the vsync
 	
 	if (windows_count==0 and (not gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)))
 		cg_error("Failed to initialize GLAD")
@@ -84,6 +96,14 @@ Window & Window::operator=(Window &&other) {
 
 Window::~Window ( ) {
 	if (!win_ptr) return;
+	// the cached assets must be released while there is still a context (the
+	// ones still in use by someone else at this point are lost)
+	if (windows_count==1) {
+		glfwMakeContextCurrent(win_ptr);
+		AssetCache::clear();
+		if (AssetCache::memoryUsage()!=0)
+			cg_info("Some cached assets are still in use when destroying the OpenGL context");
+	}
 	if (imgui_context) {
 		ImGui::SetCurrentContext(imgui_context);
 		ImGui_ImplOpenGL3_Shutdown();
@@ -96,6 +116,7 @@ Window::~Window ( ) {
 }
 
 void Window::ImGuiDialog (const char * title, const std::function<void()> & func) {
+	PROFILE_SCOPE("ImGui");
 	cg_assert(imgui_context,"ImGui not initialized for this window");
 	ImGui::SetCurrentContext(imgui_context);
 	ImGui_ImplOpenGL3_NewFrame();
@@ -105,6 +126,7 @@ void Window::ImGuiDialog (const char * title, const std::function<void()> & func
 	func();
 	if (title) ImGui::End();
 	ImGui::Render();
+	PROFILE_GPU_SCOPE("ImGui");
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
@@ -117,7 +139,7 @@ FrameTimer::FrameTimer() {
 }
 
 double FrameTimer::newFrame() {
-	double cur = glfwGetTime();
+	double cur = Benchmark::isActive() ? prev+Benchmark::getTimeStep() : glfwGetTime();
 	double delta = cur-prev;
 	prev  = cur;
 	++fps_aux;
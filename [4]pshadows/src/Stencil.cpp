@@ -31,6 +31,7 @@ static glm::vec4 getColor(int i) {
 }
 
 ShowStencil::ShowStencil() : shader("shaders/stencil") {
+	loc_color = shader.getUniform<glm::vec4>("color");
 	glGenVertexArrays(1,&VAO);
 	glBindVertexArray(VAO);
 	std::vector<glm::vec3> vpos = {
@@ -41,7 +42,7 @@ ShowStencil::ShowStencil() : shader("shaders/stencil") {
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, vpos.size()*sizeof(glm::vec3), vpos.data(), GL_STATIC_DRAW);
-	int loc_pos = 0;
+	int loc_pos = GeometryRenderer::aPosition; // same location as in every Shader
 	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(loc_pos);
 	glBindVertexArray(0);
@@ -53,7 +54,7 @@ void ShowStencil::draw(int max) {
 	glEnable(GL_STENCIL_TEST);
 	glStencilOp(GL_KEEP,GL_KEEP,GL_KEEP);
 	for(int ref=0;ref<max;++ref) {
-		shader.setUniform("color",getColor(ref));
+		shader.setUniform(loc_color,getColor(ref));
 		glStencilFunc(GL_EQUAL,ref,255);
 		glDrawArrays(GL_TRIANGLE_FAN,0,4);
 	}
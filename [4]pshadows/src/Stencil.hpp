@@ -13,6 +13,7 @@ public:
 private:
 	GLuint VAO=0, VBO=0;
 	Shader shader;
+	Shader::Uniform<glm::vec4> loc_color;
 };
 
 int getStencilValueUnderMouseCursor(GLFWwindow *window);
@@ -7,11 +7,15 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include "Model.hpp"
+#include "ModelLoader.hpp"
 #include "Window.hpp"
 #include "Callbacks.hpp"
 #include "Debug.hpp"
 #include "Shaders.hpp"
 #include "Stencil.hpp"
+#include "TextureLoader.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20220919
 
@@ -27,6 +31,9 @@ bool rotate_object = true, rotate_light = true, show_stencil = false;
 // extra callbacks
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
 
+// scripted inputs for the benchmark mode
+void benchmarkInput(GLFWwindow *window, int frame);
+
 void drawObject(const glm::mat4 &m1);
 void drawFloor(bool light_on);
 void drawLight();
@@ -34,7 +41,10 @@ void drawLight();
 glm::mat4 getReflectionMatrix();
 glm::mat4 getShadowMatrix();
 
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" runs a headless benchmark instead (see Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Demo",Window::fDefaults|Window::fBlend);
@@ -50,18 +60,32 @@ int main() {
 	mfloor = Model::loadSingle("floor",Model::fDontFit);
 	mlight = Model::loadSingle("light",Model::fDontFit);
 	int loaded_model = -1;
+	ModelLoader loader;
+	std::vector<Model> new_model;
 	FrameTimer ftime;
 	view_target.y = .75f;
 	view_pos.z *= 2;
 	do {
 		
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(window,Benchmark::getFrame());
+		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
 		
-		// reload model if necessary
+		// searches by name in the shaders during the previous frame (should be 0)
+		int shader_lookups = Shader::getLookupCount();
+		Shader::resetLookupCount();
+		
+		// reload model if necessary (in background, the previous one is still
+		// drawn until the new one is ready)
 		if (loaded_model!=current_model) { 
-			mobject = Model::loadSingle(models_names[current_model]);
+			loader.request(models_names[current_model],Model::fLods);
 			loaded_model = current_model;
 		}
+		if (loader.update(new_model)) mobject = std::move(new_model[0]);
+		
+		// upload some more of the textures that are still loading
+		TextureLoader::update();
 		
 		view_angle = std::min(std::max(view_angle,0.01f),1.72f);
 		
@@ -76,6 +100,9 @@ int main() {
 		lpos.z = 2.0f*std::cos(angle_light);
 		lpos.w = 1.0f;
 		
+		// camera and light, for all the shaders
+		setFrameData(lpos, glm::vec3{1.f,1.f,1.f}, 0.4f);
+		
 		// get matrixes for drawObject
 		glm::mat4 identity(1.f);
 		glm::mat4 shadow = getShadowMatrix();
@@ -84,6 +111,7 @@ int main() {
 		
 		// prepare stencil
 		/// @todo: generar valores diferentes en fondo, piso iluminado, sombra
+		Profiler::beginGpu("stencil");
 		//Habilitamos el stencil-test
 		glEnable(GL_STENCIL_TEST);
 		
@@ -102,10 +130,12 @@ int main() {
 		glDepthFunc(GL_NEVER);
 		//"dibujamos" los fragmentos que corresponden a la sombra del modelo
 		drawObject(shadow);
+		Profiler::endGpu();
 		
 		
 		// draw objects
 		/// @todo: seleccionar la mascara y el valor de referencia adecuado para cada objeto
+		Profiler::beginGpu("opaque");
 		
 		//Primero objetos opacos
 		//Modelo normal y luz (sin stencil test y con depth test normal)
@@ -113,14 +143,18 @@ int main() {
 		glDepthFunc(GL_LESS);
 		drawObject(identity);
 		drawLight();
+		Profiler::endGpu();
 		
 		//Reflejo (0 < stencil buffer) (Si, la sintaxis es "al reves" (horrible))
 		glEnable(GL_STENCIL_TEST);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 		glStencilFunc(GL_LESS, 0, ~0);
+		Profiler::beginGpu("reflection");
 		drawObject(reflection);
+		Profiler::endGpu();
 		
 		//Ultimo transparencias
+		Profiler::beginGpu("floor");
 		//Piso iluminado (stencil buffer = 1)
 		glStencilFunc(GL_EQUAL, 1, ~0);
 		drawFloor(true);
@@ -128,8 +162,10 @@ int main() {
 		//Piso con sombra (stencil buffer = 2)
 		glStencilFunc(GL_EQUAL, 2, ~0);
 		drawFloor(false);
+		Profiler::endGpu();
 		
 		if (show_stencil) {
+			PROFILE_GPU_SCOPE("show stencil");
 			static ShowStencil ss;
 			ss.draw(256);
 		}
@@ -142,13 +178,20 @@ int main() {
 			ImGui::Checkbox("Show Stencil (S)",&show_stencil);
 			int v = getStencilValueUnderMouseCursor(window);
 			ImGui::Text("Value under mouse: %i",v);
+			ImGui::Text("Shader lookups: %i",shader_lookups);
+			Profiler::drawImGui();
 		});
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	
+	// the models are globals, so they (and their textures, shared through the
+	// AssetCache) must be released here, while the window is still alive
+	mobject = Model(); mfloor = Model(); mlight = Model();
+	shader_texture = Shader(); shader_phong = Shader();
 }
 
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods) {
@@ -162,11 +205,19 @@ void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, i
 	}
 }
 
-void drawModel(const Model &model, const glm::mat4 &m = glm::mat4(1.f)) {
+// every model (object and light rotate by default), showing the stencil
+// half of the time
+void benchmarkInput(GLFWwindow *window, int frame) {
+	if (frame%120==60) keyboardCallback(window,'S',0,GLFW_PRESS,0);
+	if (frame%240==239) keyboardCallback(window,'O',0,GLFW_PRESS,0);
+}
+
+// material_index: to draw with other material (-1 to use the model's one)
+void drawModel(const Model &model, const glm::mat4 &m = glm::mat4(1.f), int material_index = -1) {
 	// select a shader
 	Shader &shader = [&]()->Shader&{
-		if (model.texture.isOk()) {
-			model.texture.bind();
+		if (model.texture) {
+			model.texture->bind();
 			return shader_texture;
 		}
 		return shader_phong;
@@ -174,32 +225,35 @@ void drawModel(const Model &model, const glm::mat4 &m = glm::mat4(1.f)) {
 	shader.use();
 	
 	auto mats = common_callbacks::getMatrixes();
-	shader.setMatrixes(mats[0]*m,mats[1],mats[2]);
+	shader.setModelMatrix(mats[0]*m);
 	
-	// setup light and material
-	shader.setLight(lpos, glm::vec3{1.f,1.f,1.f}, 0.4f);
-	shader.setMaterial(model.material);
+	// setup material (camera and light are in FrameData)
+	shader.setMaterial(material_index==-1 ? model.material_index : material_index);
 	
-	// send geometry
-	shader.setBuffers(model.buffers);
-	model.buffers.draw();
+	// send geometry (simplified if it is far away); selectLod assumes an
+	// affine m, so the projected shadow (w row != 0,0,0,1) always uses lod 0
+	bool projective = m[0][3]!=0.f or m[1][3]!=0.f or m[2][3]!=0.f or m[3][3]!=1.f;
+	const GeometryRenderer &buffers = projective ? model.buffers
+	                                         : model.selectLod(mats[1]*mats[0]*m,mats[2],win_height);
+	shader.setBuffers(buffers);
+	buffers.draw();
 }
 
 void drawObject(const glm::mat4 &m1) {
+	if (mobject.buffers.vertexArray()==0) return; // not loaded yet
 	auto m2 = glm::translate( m1, glm::vec3(0.f,1.f,0.f) );
 	auto m3 = glm::rotate( m2, 0.5f*angle_object, glm::vec3(std::sin(2.f*angle_object)/5.f,1.f,std::cos(2.f*angle_object)/5.f) );
 	drawModel(mobject,m3);
 }
 
 void drawFloor(bool light_on) {
-	static Material mat_orig = mfloor.material;
-	if (light_on) {
-		mfloor.material.kd = mat_orig.kd;
-		mfloor.material.ks = mat_orig.ks;
-	} else {
-		mfloor.material.kd = mfloor.material.ks = glm::vec3(0.f,0.f,0.f);
-	}
-	drawModel(mfloor);
+	// the shadowed floor only has the ambient component
+	static int mat_shadow = [](){
+		Material mat = mfloor.material;
+		mat.kd = mat.ks = glm::vec3(0.f,0.f,0.f);
+		return MaterialTable::getIndex(mat);
+	}();
+	drawModel(mfloor,glm::mat4(1.f),light_on ? mfloor.material_index : mat_shadow);
 }
 
 void drawLight() {
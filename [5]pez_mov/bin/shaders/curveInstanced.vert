@@ -0,0 +1,23 @@
+#version 330 core
+
+// one instance per piece (cubic), with its control points and its number of
+// segments (each instance gets as many vertexes as the piece with more
+// segments, the ones past its own count repeat its last point)
+in vec3 p0, p1, p2, p3;
+in int segments;
+
+uniform mat4 modelMatrix;
+uniform int controlPolygon; // 1: the control points instead of the curve
+#include "funcs/frameData.glsl"
+
+void main() {
+	vec3 pos;
+	if (controlPolygon!=0) {
+		vec3 p[4] = vec3[4](p0,p1,p2,p3);
+		pos = p[gl_VertexID];
+	} else {
+		float t = float(min(gl_VertexID,segments))/float(segments), s = 1.0-t;
+		pos = s*s*s*p0 + 3.0*s*s*t*p1 + 3.0*s*t*t*p2 + t*t*t*p3;
+	}
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(pos,1.0);
+}
@@ -4,17 +4,19 @@ in vec3 vertexPosition;
 in vec3 vertexNormal;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 lightPosition;
+#include "funcs/frameData.glsl"
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec4 lightVSPosition;
 
+#include "funcs/decodeVertex.vert"
+
 void main() {
-	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertexPosition,1.f);
-	fragPosition = vec3(modelMatrix * vec4(vertexPosition,1.f));
-	fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * vertexNormal;
+	vec3 position = decodePosition(vertexPosition);
+	vec3 normal = decodeNormal(vertexNormal);
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position,1.f);
+	fragPosition = vec3(modelMatrix * vec4(position,1.f));
+	fragNormal = mat3(transpose(inverse(viewMatrix*modelMatrix))) * normal;
 	lightVSPosition = viewMatrix * lightPosition;
 }
@@ -0,0 +1,112 @@
+#include <list>
+#include <unordered_map>
+#include "AssetCache.hpp"
+#include "Debug.hpp"
+
+namespace {
+
+struct Entry {
+	std::string key;
+	std::shared_ptr<const void> asset;
+	size_t size;
+};
+
+// entries sorted from the most recently requested to the least recently one
+struct Cache {
+	std::list<Entry> entries;
+	std::unordered_map<std::string,std::list<Entry>::iterator> index;
+	size_t budget = 256*1024*1024, used = 0;
+};
+
+Cache &getCache() {
+	static Cache cache;
+	return cache;
+}
+
+// releases the least recently requested entries that are not in use (the
+// cache has the only reference) until the used memory fits in the budget (or
+// all of them if everything is true); releasing a model can release its
+// textures, so it repeats while it can
+void evict(Cache &cache, size_t budget, bool everything=false) {
+	for(bool released=true; released and (everything or cache.used>budget); ) {
+		released = false;
+		for(auto it=cache.entries.end(); (everything or cache.used>budget) and it!=cache.entries.begin(); ) {
+			--it;
+			if (it->asset.use_count()>1) continue;
+			cache.used -= it->size;
+			cache.index.erase(it->key);
+			it = cache.entries.erase(it);
+			released = true;
+		}
+	}
+}
+
+// returns the cached asset for key (marking it as the most recent one), or
+// loads it with load() and caches it (its size is given by size(asset))
+template<typename T, typename Load, typename Size>
+std::shared_ptr<T> getAsset(const std::string &key, const Load &load, const Size &size) {
+	Cache &cache = getCache();
+	auto it = cache.index.find(key);
+	if (it!=cache.index.end()) {
+		cache.entries.splice(cache.entries.begin(),cache.entries,it->second);
+		return std::static_pointer_cast<T>(std::const_pointer_cast<void>(it->second->asset));
+	}
+	std::shared_ptr<T> asset = load();
+	cache.entries.push_front({key,asset,size(*asset)});
+	cache.index[key] = cache.entries.begin();
+	cache.used += cache.entries.front().size;
+	evict(cache,cache.budget);
+	return asset;
+}
+
+}
+
+AssetCache::ModelsHandle AssetCache::models(const std::string &name, int flags) {
+	cg_assert(!(flags&Model::fDynamic),"fDynamic models can not be shared");
+	return getAsset<const std::vector<Model>>("model:"+name+":"+std::to_string(flags),
+		[&]() { return std::make_shared<const std::vector<Model>>(Model::load(name,flags)); },
+		[](const std::vector<Model> &models) {
+			size_t size = 0;
+			for(const Model &model : models) {
+				size += model.buffers.memorySize();
+				for(const Model::Lod &lod : model.lods)
+					size += lod.buffers.memorySize();
+			}
+			return size; // the textures are separated entries
+		});
+}
+
+AssetCache::TextureHandle AssetCache::texture(const std::string &fname, bool repeat_s, bool repeat_t) {
+	return getAsset<const Texture>("texture:"+fname+":"+(repeat_s?"1":"0")+(repeat_t?"1":"0"),
+		[&]() { return std::make_shared<const Texture>(fname,repeat_s,repeat_t,true); },
+		[](const Texture &texture) { return texture.memorySize(); });
+}
+
+AssetCache::ShaderHandle AssetCache::shader(const std::string &fname) {
+	return shader(fname+".vert",fname+".frag");
+}
+
+AssetCache::ShaderHandle AssetCache::shader(const std::string &vertex_fname, const std::string &fragment_fname) {
+	return getAsset<Shader>("shader:"+vertex_fname+":"+fragment_fname,
+		[&]() { return std::make_shared<Shader>(vertex_fname,fragment_fname); },
+		[](const Shader &) { return size_t(0); });
+}
+
+void AssetCache::setBudget(size_t bytes) {
+	Cache &cache = getCache();
+	cache.budget = bytes;
+	evict(cache,cache.budget);
+}
+
+size_t AssetCache::getBudget() {
+	return getCache().budget;
+}
+
+size_t AssetCache::memoryUsage() {
+	return getCache().used;
+}
+
+void AssetCache::clear() {
+	evict(getCache(),0,true);
+}
+
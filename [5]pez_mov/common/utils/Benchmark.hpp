@@ -0,0 +1,32 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <iosfwd>
+#include <string>
+
+// headless benchmark mode: with "--bench N" in the command line the demo runs
+// N frames in a hidden window (without a display, if there is none, with
+// mesa's software rendering), with a fixed time step and its own scripted
+// inputs, and then writes a report as JSON (to stdout, or to the file given
+// with "--bench-out file"): the frame times (percentiles), the time of each
+// phase (from the Profiler) and the peak memory used
+class Benchmark {
+public:
+	// must be called before creating the window; false if the arguments are
+	// wrong (and then the benchmark is not active)
+	static bool init(int argc, char *argv[]);
+
+	static bool isActive();
+	static int getFrame(); // the current one, from 0
+	static int getFramesCount();
+	static double getTimeStep(); // the simulated dt of every frame
+
+	// at the end of each frame; false after the last one, when it also writes
+	// the report (always true if not active)
+	static bool nextFrame();
+
+	static bool writeReport(std::ostream &out);
+};
+
+#endif
+
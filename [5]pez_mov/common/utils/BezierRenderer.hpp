@@ -2,39 +2,126 @@
 #define BEZIERRENDERER_HPP
 #include <glad/glad.h>
 #include "Shaders.hpp"
+#include "Debug.hpp"
 
 class BezierRenderer {
 public:
 	BezierRenderer(int nsamples=100);
 	~BezierRenderer();
 	Shader &getShader();
+	// the curve in nsamples uniform samples of t
 	template<typename Bezier>
 	void update(Bezier &b);
+	// the curve as a polyline within tolerance of it (see Bezier::flatten),
+	// with the distances measured after to_screen (to give the tolerance in
+	// pixels); straight or short pieces get only a few vertexes
+	template<typename Bezier, typename F>
+	void update(Bezier &b, float tolerance, const F &to_screen);
+	template<typename Bezier>
+	void update(Bezier &b, float tolerance);
 	void drawPoly(bool full=true);
 	void drawCurve();
+	
+	// all the pieces of a spline (cubic curves) at once, evaluated in the
+	// vertex shader (shaders/curveInstanced.vert, loaded when first needed):
+	// setPieces uploads their control points and the number of segments of
+	// each one to a single buffer (call it again only when they change), and
+	// each draw is one instanced call, with an instance per piece, so the
+	// number of calls does not depend on the pieces; every piece gets
+	// nsamples-1 uniform segments, or, with a tolerance, the ones it needs to
+	// stay within it (see Bezier::segmentsCount, up to nsamples-1)
+	template<typename Bezier>
+	void setPieces(const std::vector<Bezier> &pieces);
+	template<typename Bezier, typename F>
+	void setPieces(const std::vector<Bezier> &pieces, float tolerance, const F &to_screen);
+	Shader &getPiecesShader();
+	void drawPiecesPoly(bool full=true);
+	void drawPiecesCurve();
 private:
 	Shader shader;
-	GLuint VAO=0, VBO[2]={0,0};
+	Shader::Attribute loc_pos;
+	Shader::Uniform<glm::vec3> loc_color;
+	GLuint VAO[2]={0,0}, VBO[2]={0,0}; // curve, poly
 	std::vector<glm::vec3> v_curve, v_poly;
+	std::vector<float> t_curve; // the values of t for v_curve
+	size_t curve_capacity = 0; // vertexes allocated in VBO[0]
 	glm::vec3 color_curve = {1.f, 1.f, 1.f};
 	glm::vec3 color_poly = {.0f, .0f, .0f};
 	glm::vec3 color_points = {0.f, 0.f, 0.f};
+	template<typename Bezier>
+	void upload(Bezier &b);
+	void uploadBuffers(); // v_curve and v_poly
+	
+	Shader pieces_shader;
+	Shader::Uniform<glm::vec3> loc_pieces_color;
+	Shader::Uniform<int> loc_pieces_poly;
+	GLuint pieces_VAO = 0, pieces_VBO[2] = {0,0}; // control points, segments
+	std::vector<glm::vec3> v_pieces; // the 4 control points of each piece
+	std::vector<GLint> s_pieces; // the segments of each piece
+	int max_segments = 0; // of all the pieces
+	int segmentsDepth() const; // max depth for Bezier::segmentsCount
+	void loadPiecesShader(); // and its VAO, the first time
+	template<typename Bezier>
+	void copyPieces(const std::vector<Bezier> &pieces);
+	void uploadPieces();
+	void drawPieces(GLenum mode, int count, bool poly, const glm::vec3 &color);
 };
 
 
 template<typename Bezier>
 void BezierRenderer::update(Bezier &b) {
-	double n = double(v_curve.size())-1;
-	for(size_t i=0;i<v_curve.size();++i)
-		v_curve[i] = b.at(double(i)/n);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, v_curve.size() * sizeof(glm::vec3), v_curve.data());
+	v_curve.resize(t_curve.size());
+	b.evalMany(t_curve.data(),int(t_curve.size()),v_curve.data());
+	upload(b);
+}
+
+template<typename Bezier, typename F>
+void BezierRenderer::update(Bezier &b, float tolerance, const F &to_screen) {
+	v_curve.clear();
+	b.flatten(tolerance,v_curve,to_screen);
+	upload(b);
+}
+
+template<typename Bezier>
+void BezierRenderer::update(Bezier &b, float tolerance) {
+	v_curve.clear();
+	b.flatten(tolerance,v_curve);
+	upload(b);
+}
+
+template<typename Bezier>
+void BezierRenderer::upload(Bezier &b) {
 	v_poly[0] = b[0];
 	v_poly[1] = b[1];
 	v_poly[2] = b[b.degree()-1];
 	v_poly[3] = b[b.degree()];
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, v_poly.size() * sizeof(glm::vec3), v_poly.data());
+	uploadBuffers();
+}
+
+template<typename Bezier>
+void BezierRenderer::copyPieces(const std::vector<Bezier> &pieces) {
+	v_pieces.clear();
+	for(const Bezier &b : pieces) {
+		cg_assert(b.degree()==3,"The instanced pieces must be cubic");
+		for(int i=0;i<=3;++i) v_pieces.push_back(b[i]);
+	}
+}
+
+template<typename Bezier>
+void BezierRenderer::setPieces(const std::vector<Bezier> &pieces) {
+	copyPieces(pieces);
+	s_pieces.assign(pieces.size(),GLint(t_curve.size())-1);
+	uploadPieces();
+}
+
+template<typename Bezier, typename F>
+void BezierRenderer::setPieces(const std::vector<Bezier> &pieces, float tolerance, const F &to_screen) {
+	copyPieces(pieces);
+	s_pieces.clear();
+	int max_depth = segmentsDepth();
+	for(const Bezier &b : pieces)
+		s_pieces.push_back(b.segmentsCount(tolerance,to_screen,max_depth));
+	uploadPieces();
 }
 
 #endif
@@ -1,3 +1,14 @@
+#include <sys/stat.h>
+#ifdef _WIN32
+#	include <direct.h>
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <unistd.h>
+#endif
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
 #include "Misc.hpp"
 #include "Debug.hpp"
 
@@ -9,7 +20,7 @@ std::string extractFolder(const std::string &filename) {
 	return filename.substr(0,i+1);
 }
 
-bool startsWith(const std::string str, const char *con) {
+bool startsWith(const std::string &str, const char *con) {
 	int i=0, l=str.size();
 	for(;con[i] && i<l;++i)
 		if (con[i]!=str[i]) return false;
@@ -32,3 +43,42 @@ std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v) {
 	}
 	return {pmin,pmax};
 }
+
+bool getFileStamp(const std::string &filename, long long &mtime, long long &size) {
+	struct stat st;
+	if (stat(filename.c_str(),&st)!=0) return false;
+	mtime = static_cast<long long>(st.st_mtime);
+	size = static_cast<long long>(st.st_size);
+	return true;
+}
+
+bool createFolder(const std::string &path) {
+#ifdef _WIN32
+	int ret = _mkdir(path.c_str());
+#else
+	int ret = mkdir(path.c_str(),0755);
+#endif
+	return ret==0 or errno==EEXIST;
+}
+
+std::string getTempFileName(const std::string &path) {
+	// the pid makes it unique also between processes writing the same file
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = getpid();
+#endif
+	static std::atomic<unsigned> count{0};
+	return path+"."+std::to_string(pid)+"."+std::to_string(count++)+".tmp";
+}
+
+bool replaceFile(const std::string &src, const std::string &dst) {
+#ifdef _WIN32
+	// rename fails there if dst exists (and this fails if dst is still mapped)
+	bool ok = MoveFileExA(src.c_str(),dst.c_str(),MOVEFILE_REPLACE_EXISTING)!=0;
+#else
+	bool ok = std::rename(src.c_str(),dst.c_str())==0;
+#endif
+	if (not ok) std::remove(src.c_str());
+	return ok;
+}
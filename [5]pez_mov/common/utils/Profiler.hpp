@@ -0,0 +1,76 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <string>
+#include <vector>
+
+// frame profiler: measures the CPU time of named scopes (nested, and from any
+// thread) and the GPU time of render passes (with timestamp queries, read some
+// frames later so the CPU never waits for the GPU), and keeps the results of
+// the last frames_count frames; the names must be string literals (or
+// __func__), only their pointers are kept
+class Profiler {
+public:
+	// once per frame, before anything else: closes the previous frame
+	static void newFrame();
+
+	static void beginCpu(const char *name);
+	static void endCpu();
+	// only in the thread with the GL context; they can be nested, but a pass
+	// must end in the same frame
+	static void beginGpu(const char *name);
+	static void endGpu();
+
+	// a collapsing section for the current ImGui window (as in
+	// Window::ImGuiDialog): the times of the frames, and the last frame with
+	// all its results as a timeline (a row per thread and nesting level, and
+	// the GPU passes below), with a button for exportTrace("profile.json")
+	static void drawImGui();
+
+	// the frames kept, in Chrome's trace event format (to open in
+	// chrome://tracing or ui.perfetto.dev); false if it can't write the file
+	static bool exportTrace(const std::string &fname);
+	
+	// the time of each scope (and of each GPU pass) added over all the frames
+	// recorded from the start (not only the ones kept), by name; only in the
+	// thread with the GL context, as it waits for the GPU results still pending
+	struct Total {
+		std::string name;
+		bool gpu = false;
+		double seconds = 0.0; // inclusive (with the nested ones)
+		long count = 0;
+	};
+	static std::vector<Total> getTotals();
+
+	// while disabled the scopes are not recorded (but still must be balanced)
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	static constexpr int frames_count = 120;
+};
+
+// a CPU (or GPU) scope from its construction until the end of the block
+class ProfileScope {
+public:
+	ProfileScope(const char *name) { Profiler::beginCpu(name); }
+	~ProfileScope() { Profiler::endCpu(); }
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+class GpuProfileScope {
+public:
+	GpuProfileScope(const char *name) { Profiler::beginGpu(name); }
+	~GpuProfileScope() { Profiler::endGpu(); }
+	GpuProfileScope(const GpuProfileScope &) = delete;
+	GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+};
+
+#define PROFILE_CONCAT_(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_(a,b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_,__LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpu_profile_scope_,__LINE__)(name)
+
+#endif
+
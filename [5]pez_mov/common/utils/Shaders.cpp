@@ -1,7 +1,10 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <unordered_map>
 #include <iostream>
+#include <cstdint>
+#include <cstdio>
 #include <glad/glad.h>
 #include "Shaders.hpp"
 #include "Debug.hpp"
@@ -28,11 +31,9 @@ static std::string getShaderSource(std::string file_path) {
 	return full_content;
 }
 
-static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
+static GLuint compile(GLenum shader_type, const std::string &file_path, const std::string &shader_code) {
 	GLuint shader_id = glCreateShader(shader_type);
 	
-	std::string shader_code = getShaderSource(file_path);
-	
 	cg_info("Compiling shader: " + file_path + "...");
 	const char *shader_code_ptr = shader_code.c_str();
 	glShaderSource(shader_id,1,&shader_code_ptr,nullptr);
@@ -51,6 +52,99 @@ static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
 	return shader_id;
 }
 
+// --- program binaries cache ---
+
+// linked programs are saved (with glGetProgramBinary) in a "cache" folder
+// next to the vertex shader, in a file named after a hash of the expanded
+// sources (with the #includes) and the driver, so an edited shader or another
+// GPU/driver just misses the cache; a binary that the driver rejects (after
+// an update, for instance) is compiled again and replaced
+
+namespace {
+
+const char binary_magic[4] = {'C','G','P','B'};
+const uint32_t binary_version = 1;
+
+// FNV-1a, 64 bits
+uint64_t hashString(const std::string &s, uint64_t h = 14695981039346656037ull) {
+	for(unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+	return h;
+}
+
+std::string glString(GLenum name) {
+	const GLubyte *s = glGetString(name);
+	return s ? reinterpret_cast<const char*>(s) : "";
+}
+
+// the folder is not created here, only when saving
+std::string getBinaryPath(const std::string &vertex_fname, const std::string &vertex_code, const std::string &fragment_code, uint64_t &hash) {
+	hash = hashString(vertex_code);
+	hash = hashString(std::string(1,'\0')+fragment_code,hash);
+	hash = hashString(std::string(1,'\0')+glString(GL_VENDOR)+glString(GL_RENDERER)+glString(GL_VERSION),hash);
+	char name[32];
+	std::snprintf(name,sizeof(name),"%016llx.bin",static_cast<unsigned long long>(hash));
+	return extractFolder(vertex_fname)+"cache/"+name;
+}
+
+bool binariesSupported() {
+	if (not GLAD_GL_ARB_get_program_binary) return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&formats);
+	return formats>0;
+}
+
+// returns 0 if there is no (valid) binary for this hash
+GLuint loadProgramBinary(const std::string &path, uint64_t hash) {
+	std::ifstream file(path,std::ios::binary);
+	if (not file.is_open()) return 0;
+	char magic[4]; uint32_t version; uint64_t file_hash; GLenum format; uint32_t size;
+	file.read(magic,4);
+	file.read(reinterpret_cast<char*>(&version),sizeof(version));
+	file.read(reinterpret_cast<char*>(&file_hash),sizeof(file_hash));
+	file.read(reinterpret_cast<char*>(&format),sizeof(format));
+	file.read(reinterpret_cast<char*>(&size),sizeof(size));
+	if (not file or std::string(magic,4)!=std::string(binary_magic,4) 
+		or version!=binary_version or file_hash!=hash) return 0;
+	std::vector<char> binary(size);
+	if (not file.read(binary.data(),size)) return 0;
+	
+	GLuint program_id = glCreateProgram();
+	glProgramBinary(program_id,format,binary.data(),size);
+	GLint result = GL_FALSE;
+	glGetProgramiv(program_id,GL_LINK_STATUS,&result);
+	if (result!=GL_TRUE) { glDeleteProgram(program_id); return 0; }
+	return program_id;
+}
+
+void saveProgramBinary(const std::string &path, uint64_t hash, GLuint program_id) {
+	GLint size = 0;
+	glGetProgramiv(program_id,GL_PROGRAM_BINARY_LENGTH,&size);
+	if (size<=0 or not createFolder(extractFolder(path))) return;
+	std::vector<char> binary(size);
+	GLenum format = 0;
+	glGetProgramBinary(program_id,size,nullptr,&format,binary.data());
+	// written with another name and then renamed, so another demo starting
+	// at the same time never loads a partially written binary
+	std::string tmp_path = getTempFileName(path);
+	std::ofstream file(tmp_path,std::ios::binary|std::ios::trunc);
+	if (not file.is_open()) return;
+	uint32_t usize = size;
+	file.write(binary_magic,4);
+	file.write(reinterpret_cast<const char*>(&binary_version),sizeof(binary_version));
+	file.write(reinterpret_cast<const char*>(&hash),sizeof(hash));
+	file.write(reinterpret_cast<const char*>(&format),sizeof(format));
+	file.write(reinterpret_cast<const char*>(&usize),sizeof(usize));
+	file.write(binary.data(),size);
+	file.close();
+	if (not file.good()) std::remove(tmp_path.c_str());
+	if (not file.good() or not replaceFile(tmp_path,path)) 
+		cg_info("Could not write shader cache "+path);
+}
+
+}
+
+int Shader::lookup_count = 0;
+
 Shader::Shader (const std::string &vertex_fname, const std::string &fragment_fname) {
 	load(vertex_fname,fragment_fname);
 }
@@ -72,13 +166,34 @@ Shader &Shader::operator=(Shader &&other) {
 
 void Shader::load(const std::string &vertex_fname, const std::string &fragment_fname) {
 	cg_assert(program_id==0,"Shader already loaded");
-	GLuint vertex_id = loadAndCompile(GL_VERTEX_SHADER,vertex_fname);
-	GLuint fragment_id = loadAndCompile(GL_FRAGMENT_SHADER,fragment_fname);
+	std::string vertex_code = getShaderSource(vertex_fname);
+	std::string fragment_code = getShaderSource(fragment_fname);
+	
+	bool use_binaries = binariesSupported();
+	uint64_t hash = 0;
+	std::string binary_path;
+	if (use_binaries) {
+		binary_path = getBinaryPath(vertex_fname,vertex_code,fragment_code,hash);
+		program_id = loadProgramBinary(binary_path,hash);
+		if (program_id) {
+			cg_info("Shader program loaded from cache: " + vertex_fname + "+" + fragment_fname);
+			introspect();
+			return;
+		}
+	}
+	
+	GLuint vertex_id = compile(GL_VERTEX_SHADER,vertex_fname,vertex_code);
+	GLuint fragment_id = compile(GL_FRAGMENT_SHADER,fragment_fname,fragment_code);
 	
 	cg_info( "Linking shader program..." );
 	program_id = glCreateProgram();
+	if (use_binaries) glProgramParameteri(program_id,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
 	glAttachShader(program_id,vertex_id);
 	glAttachShader(program_id,fragment_id);
+	// same locations in every program, the ones of GeometryRenderer's VAOs
+	glBindAttribLocation(program_id,GeometryRenderer::aPosition,"vertexPosition");
+	glBindAttribLocation(program_id,GeometryRenderer::aNormal,"vertexNormal");
+	glBindAttribLocation(program_id,GeometryRenderer::aTexCoords,"vertexTexCoords");
 	glLinkProgram(program_id);
 	
 	GLint result = GL_FALSE, log_len = 0;
@@ -96,6 +211,94 @@ void Shader::load(const std::string &vertex_fname, const std::string &fragment_f
 	
 	glDeleteShader(vertex_id);
 	glDeleteShader(fragment_id);
+	
+	if (use_binaries) saveProgramBinary(binary_path,hash,program_id);
+	
+	introspect();
+}
+
+void Shader::introspect() {
+	GLint count = 0, max_len = 0;
+	std::vector<char> name;
+	auto getAll = [&](GLenum count_name, GLenum max_len_name, auto getActive, auto getLocation, 
+					  std::unordered_map<std::string,Location> &table) 
+	{
+		glGetProgramiv(program_id,count_name,&count);
+		glGetProgramiv(program_id,max_len_name,&max_len);
+		name.resize(max_len+1);
+		for(GLint i=0;i<count;++i) {
+			GLint size; GLenum type;
+			getActive(program_id,i,GLsizei(name.size()),nullptr,&size,&type,name.data());
+			GLint location = getLocation(program_id,name.data());
+			if (location==-1) continue; // in a uniform block, or a built-in
+			table[name.data()] = {location,type};
+			std::string str = name.data();
+			if (str.size()>3 and str.compare(str.size()-3,3,"[0]")==0)
+				table[str.substr(0,str.size()-3)] = {location,type};
+		}
+	};
+	uniforms.clear(); attributes.clear();
+	getAll(GL_ACTIVE_UNIFORMS,GL_ACTIVE_UNIFORM_MAX_LENGTH,glGetActiveUniform,glGetUniformLocation,uniforms);
+	getAll(GL_ACTIVE_ATTRIBUTES,GL_ACTIVE_ATTRIBUTE_MAX_LENGTH,glGetActiveAttrib,glGetAttribLocation,attributes);
+	
+	common.model_matrix.location = findUniform("modelMatrix",GL_FLOAT_MAT4);
+	common.view_matrix.location = findUniform("viewMatrix",GL_FLOAT_MAT4);
+	common.projection_matrix.location = findUniform("projectionMatrix",GL_FLOAT_MAT4);
+	common.diffuse_color.location = findUniform("diffuseColor",GL_FLOAT_VEC3);
+	common.specular_color.location = findUniform("specularColor",GL_FLOAT_VEC3);
+	common.ambient_color.location = findUniform("ambientColor",GL_FLOAT_VEC3);
+	common.emission_color.location = findUniform("emissionColor",GL_FLOAT_VEC3);
+	common.opacity.location = findUniform("opacity",GL_FLOAT);
+	common.shininess.location = findUniform("shininess",GL_FLOAT);
+	common.material_index.location = findUniform("materialIndex",GL_INT);
+	common.light_position.location = findUniform("lightPosition",GL_FLOAT_VEC4);
+	common.light_color.location = findUniform("lightColor",GL_FLOAT_VEC3);
+	common.ambient_strength.location = findUniform("ambientStrength",GL_FLOAT);
+	common.position_scale.location = findUniform("positionScale",GL_FLOAT_VEC3);
+	common.position_offset.location = findUniform("positionOffset",GL_FLOAT_VEC3);
+	common.quantized_normals.location = findUniform("quantizedNormals",GL_FLOAT);
+	common.vertex_position.location = findAttribute("vertexPosition");
+	common.vertex_normal.location = findAttribute("vertexNormal");
+	common.vertex_tex_coords.location = findAttribute("vertexTexCoords");
+	
+	GLuint frame_data = glGetUniformBlockIndex(program_id,"FrameData");
+	if (frame_data!=GL_INVALID_INDEX) 
+		glUniformBlockBinding(program_id,frame_data,FrameData::binding_point);
+	GLuint materials = glGetUniformBlockIndex(program_id,"Materials");
+	if (materials!=GL_INVALID_INDEX) 
+		glUniformBlockBinding(program_id,materials,MaterialTable::binding_point);
+}
+
+namespace {
+
+bool isSampler(GLenum type) {
+	switch (type) {
+	case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW:
+	case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D: return true;
+	default: return false;
+	}
+}
+
+}
+
+GLint Shader::findUniform(const char *name, GLenum type) const {
+	auto it = uniforms.find(name);
+	if (it==uniforms.end()) return -1;
+	// bools can be set as floats, and samplers as ints (their texture unit)
+	cg_assert(it->second.type==type or (type==GL_FLOAT and it->second.type==GL_BOOL)
+			  or (type==GL_INT and isSampler(it->second.type)),
+			  "Wrong type for uniform "+std::string(name));
+	return it->second.location;
+}
+
+GLint Shader::findAttribute(const char *name) const {
+	auto it = attributes.find(name);
+	return it==attributes.end() ? -1 : it->second.location;
+}
+
+Shader::Attribute Shader::getAttribute(const char *name) const {
+	++lookup_count;
+	return Attribute{findAttribute(name)};
 }
 
 void Shader::load(const std::string &fname) {
@@ -103,80 +306,97 @@ void Shader::load(const std::string &fname) {
 }
 
 
-bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool required) {
+bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool required, GLsizei stride, size_t offset) {
 	glBindBuffer(GL_ARRAY_BUFFER,id); /// todo: no va type?
-	GLint loc = glGetAttribLocation(program_id, name); 
+	GLint loc = getAttribute(name).location;
 	if (loc==-1 and (not required)) return false;
 	cg_assert(loc!=-1,"Shader does not have required attribute");
-	glVertexAttribPointer(loc, size, type, GL_FALSE, 0, 0);
+	glVertexAttribPointer(loc, size, type, GL_FALSE, stride, reinterpret_cast<const void*>(offset));
 	glEnableVertexAttribArray(loc);
 	return true;
 }
 
 void Shader::setBuffers (const GeometryRenderer & geo) {
-	glBindVertexArray(geo.vertexArray());
-	
-	{ // positions
-		glBindBuffer(GL_ARRAY_BUFFER,geo.positionsVBO());
-		GLint loc_pos = glGetAttribLocation(program_id, "vertexPosition"); 
-		cg_assert(loc_pos!=-1,"Shader does not have vertexPosition attribute");
-		glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(loc_pos);
-	}
+	// the attributes are already in the geometry's VAO (see GeometryRenderer::draw)
+	cg_assert(common.vertex_position.isOk(),"Shader does not have vertexPosition attribute");
+	cg_assert(not common.vertex_normal.isOk() or geo.normalsVBO()!=0,"Geometry does not have normals");
+	cg_assert(not common.vertex_tex_coords.isOk() or geo.texCoordsVBO()!=0,"Geometry does not have texture coordinates");
 	
-	GLint loc_norm = glGetAttribLocation(program_id, "vertexNormal"); 
-	if (loc_norm!=-1) { // normals
-		cg_assert(geo.normalsVBO()!=0,"Geometry does not have normals");
-		glBindBuffer(GL_ARRAY_BUFFER,geo.normalsVBO());
-		glVertexAttribPointer(loc_norm, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(loc_norm);
+	// for decoding quantized attributes (see shaders/funcs/decodeVertex.vert),
+	// they are ignored by shaders that do not include it; only sent when they
+	// change (most geometries are not quantized)
+	float quantized_normals = geo.quantizedNormals()?1.f:0.f;
+	if (not quantization.valid or quantization.scale!=geo.positionScale() 
+		or quantization.offset!=geo.positionOffset() or quantization.normals!=quantized_normals) 
+	{
+		setUniform(common.position_scale,geo.positionScale());
+		setUniform(common.position_offset,geo.positionOffset());
+		setUniform(common.quantized_normals,quantized_normals);
+		quantization = { geo.positionScale(), geo.positionOffset(), quantized_normals, true };
 	}
-	
-	GLint loc_tc = glGetAttribLocation(program_id, "vertexTexCoords"); 
-	if (loc_tc!=-1) { // texture coords
-		glBindBuffer(GL_ARRAY_BUFFER,geo.texCoordsVBO());
-		cg_assert(geo.texCoordsVBO()!=0,"Geometry does not have texture coordinates");
-		glVertexAttribPointer(loc_tc, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(loc_tc);
-	}
-	
 }
 
 bool Shader::setUniform(const char *name, float v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniform1f(pos,v);
-	return true;
+	return setUniform(getUniform<float>(name),v);
 }
 
 bool Shader::setUniform(const char *name, const glm::vec3 &v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniform3f(pos,v.x,v.y,v.z);
-	return true;
+	return setUniform(getUniform<glm::vec3>(name),v);
 }
 
 bool Shader::setUniform(const char *name, const glm::vec4 &v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniform4f(pos,v.x,v.y,v.z,v.w);
-	return true;
+	return setUniform(getUniform<glm::vec4>(name),v);
 }
 
 bool Shader::setUniform(const char *name, const glm::mat4 &m) {
-	GLint pos = glGetUniformLocation(program_id, name); 
-	if (pos==-1) return false;
-	glUniformMatrix4fv(pos, 1, GL_FALSE, &m[0][0]);
+	return setUniform(getUniform<glm::mat4>(name),m);
+}
+
+bool Shader::setUniform(Uniform<int> u, int v) {
+	if (u.location==-1) return false;
+	glUniform1i(u.location,v);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<float> u, float v) {
+	if (u.location==-1) return false;
+	glUniform1f(u.location,v);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<glm::vec3> u, const glm::vec3 &v) {
+	if (u.location==-1) return false;
+	glUniform3f(u.location,v.x,v.y,v.z);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<glm::vec4> u, const glm::vec4 &v) {
+	if (u.location==-1) return false;
+	glUniform4f(u.location,v.x,v.y,v.z,v.w);
+	return true;
+}
+
+bool Shader::setUniform(Uniform<glm::mat4> u, const glm::mat4 &m) {
+	if (u.location==-1) return false;
+	glUniformMatrix4fv(u.location, 1, GL_FALSE, &m[0][0]);
 	return true;
 }
 
 void Shader::setMaterial (const Material &mat) {
-	setUniform("diffuseColor", mat.kd);
-	setUniform("specularColor", mat.ks);
-	setUniform("ambientColor", mat.ka);
-	setUniform("emissionColor", mat.ke);
-	setUniform("opacity", mat.opacity);
-	setUniform("shininess", mat.shininess);
+	if (common.material_index.isOk()) {
+		setMaterial(MaterialTable::getIndex(mat));
+		return;
+	}
+	setUniform(common.diffuse_color, mat.kd);
+	setUniform(common.specular_color, mat.ks);
+	setUniform(common.ambient_color, mat.ka);
+	setUniform(common.emission_color, mat.ke);
+	setUniform(common.opacity, mat.opacity);
+	setUniform(common.shininess, mat.shininess);
+}
+
+void Shader::setMaterial (int material_index) {
+	setUniform(common.material_index,material_index);
 }
 
 Shader::~Shader ( ) {
@@ -189,15 +409,19 @@ void Shader::use() const {
 }
 
 void Shader::setMatrixes (const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection) {
-	setUniform("modelMatrix",model);
-	setUniform("viewMatrix",view);
-	setUniform("projectionMatrix",projection);
+	setUniform(common.model_matrix,model);
+	setUniform(common.view_matrix,view);
+	setUniform(common.projection_matrix,projection);
+}
+
+void Shader::setModelMatrix (const glm::mat4 &model) {
+	setUniform(common.model_matrix,model);
 }
 
 void Shader::setLight (const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
-	setUniform("lightPosition",lightPosition);
-	setUniform("lightColor",lightColor);
-	setUniform("ambientStrength",ambientStrength);
+	setUniform(common.light_position,lightPosition);
+	setUniform(common.light_color,lightColor);
+	setUniform(common.ambient_strength,ambientStrength);
 }
 
 void Shader::setLightX(int i, const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
@@ -210,3 +434,60 @@ void Shader::setLightX(int i, const glm::vec4 &lightPosition, const glm::vec3 &l
 	setUniform(cs_as,ambientStrength);
 }
 
+static_assert(sizeof(FrameData)==160,"FrameData does not match the std140 layout");
+
+constexpr GLuint FrameData::binding_point;
+
+void FrameData::upload() const {
+	static GLuint buffer_id = 0;
+	if (buffer_id==0) {
+		glGenBuffers(1,&buffer_id);
+		glBindBuffer(GL_UNIFORM_BUFFER,buffer_id);
+		glBufferData(GL_UNIFORM_BUFFER,sizeof(FrameData),nullptr,GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER,binding_point,buffer_id);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER,buffer_id);
+	glBufferSubData(GL_UNIFORM_BUFFER,0,sizeof(FrameData),this);
+}
+
+// a material as in materials.glsl (std140)
+struct MaterialData {
+	glm::vec3 ambient; float opacity;
+	glm::vec3 diffuse; float shininess;
+	glm::vec3 specular; float pad0;
+	glm::vec3 emission; float pad1;
+};
+static_assert(sizeof(MaterialData)==64,"MaterialData does not match the std140 layout");
+
+constexpr int MaterialTable::max_materials;
+constexpr GLuint MaterialTable::binding_point;
+
+static std::vector<Material> table_materials;
+
+int MaterialTable::getIndex(const Material &mat) {
+	for(size_t i=0;i<table_materials.size();++i) {
+		const Material &m = table_materials[i];
+		if (m.ka==mat.ka and m.kd==mat.kd and m.ks==mat.ks and m.ke==mat.ke 
+			and m.shininess==mat.shininess and m.opacity==mat.opacity) 
+				return i;
+	}
+	cg_assert(table_materials.size()<size_t(max_materials),"Too many materials");
+	static GLuint buffer_id = 0;
+	if (buffer_id==0) {
+		glGenBuffers(1,&buffer_id);
+		glBindBuffer(GL_UNIFORM_BUFFER,buffer_id);
+		glBufferData(GL_UNIFORM_BUFFER,max_materials*sizeof(MaterialData),nullptr,GL_STATIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER,binding_point,buffer_id);
+	}
+	MaterialData data = { mat.ka, mat.opacity, mat.kd, mat.shininess, mat.ks, 0.f, mat.ke, 0.f };
+	int index = table_materials.size();
+	glBindBuffer(GL_UNIFORM_BUFFER,buffer_id);
+	glBufferSubData(GL_UNIFORM_BUFFER,index*sizeof(MaterialData),sizeof(MaterialData),&data);
+	table_materials.push_back(mat);
+	return index;
+}
+
+int MaterialTable::size() {
+	return table_materials.size();
+}
+
@@ -13,6 +13,9 @@
 #include "Shaders.hpp"
 #include "BezierRenderer.hpp"
 #include "Spline.hpp"
+#include "TextureLoader.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20221004
 
@@ -23,6 +26,8 @@ bool show_axis = false, show_fish = false, show_spline = true, show_poly = true,
 static const int degree = 3;
 int ctrl_pt = -1, cant_pts = 6; // pto de control seleccionado (para el evento de arrastre)
 Spline spline( { {-1.f,0.f,0.f}, {0.f,0.f,-1.f}, {1.f,0.f,0.f}, {0.f,0.f,1.f} } );
+bool spline_dirty = true; // hay que volver a subir sus puntos de control al BezierRenderer
+glm::mat4 spline_to_pixels; // la transformacin con la que se calcularon sus segmentos
 
 void updateControlPointsAround(Spline &spline, int ctrl_pt) {
 	/// @todo: actualizar los puntos anterior y posterior a ctrl_pt
@@ -56,6 +61,9 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
 void characterCallback(GLFWwindow* glfw_win, unsigned int code);
 
+// entradas simuladas para el modo benchmark
+void benchmarkInput(GLFWwindow *window, int frame);
+
 glm::mat4 getTransform(const Spline &spline, double t) {
 	/// @todo: obtener los ejes y la nueva posicion del origen en funcion
 	///        de la curva y el valor del parametro t
@@ -91,9 +99,13 @@ void remapSpline(Spline &spline, int cant_pts) {
 	spline = Spline(vp);
 	for(int i=0;i<spline.getControlPointsCount();i+=degree) 
 		updateControlPointsAround(spline,i);
+	spline_dirty = true;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" corre un benchmark sin ventana visible (ver Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Demo",true);
@@ -108,6 +120,7 @@ int main() {
 	glEnable(GL_BLEND);
 	glClearColor(0.4f,0.4f,0.7f,1.f);
 	Shader shader_fish("shaders/fish");
+	auto loc_t = shader_fish.getUniform<float>("t");
 	Shader shader_phong("shaders/phong");
 	auto fish = Model::load("fish",Model::fKeepGeometry|Model::fDynamic);
 	auto axis = Model::load("axis",Model::fDontFit);
@@ -119,48 +132,66 @@ int main() {
 	float t = 0.f, speed = .05f;
 	do {
 		
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(window,Benchmark::getFrame());
+		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
+		// upload some more of the textures that are still loading
+		TextureLoader::update();
+		
 		remapSpline(spline,cant_pts);
 		
+		// camera and light, for all the shaders
+		setFrameData(glm::vec4{-2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
+		
 		// draw models and curve
 		float dt = ftime.newFrame();
 		if (animate) {
 			t += dt*speed; while (t>1.f) t-=1.f; 
 		}
 		if (show_fish) {
+			PROFILE_GPU_SCOPE("fish");
 			shader_fish.use();
-			shader_fish.setLight(glm::vec4{-2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
-			shader_fish.setUniform("t",t*20);
+			shader_fish.setUniform(loc_t,t*20);
 			glm::mat4 m = getTransform(spline, t);
 			auto mats = common_callbacks::getMatrixes();
 			for(Model &model : fish) {
-				shader_fish.setMatrixes(mats[0]*m,mats[1],mats[2]);
+				shader_fish.setModelMatrix(mats[0]*m);
 				shader_fish.setBuffers(model.buffers);
-				shader_fish.setMaterial(model.material);
+				shader_fish.setMaterial(model.material_index);
 				model.buffers.draw();
 			}
 		}
 		
 		if (show_spline or show_poly) {
-			setMatrixes(bezier_renderer.getShader());
-			for(const auto & curve : spline.getPieces()) {
-				bezier_renderer.update(curve);
-				glPointSize(1);
-				if (show_spline) bezier_renderer.drawCurve();
-				glPointSize(5);
-				if (show_poly) bezier_renderer.drawPoly();
+			PROFILE_GPU_SCOPE("spline");
+			// all the pieces in one instanced draw, evaluated in the vertex shader,
+			// each one with the segments it needs to stay within half a pixel of
+			// the curve (on screen), so they are computed again if the spline, the
+			// camera or the window change
+			auto mats = common_callbacks::getMatrixes();
+			glm::mat4 to_pixels = glm::scale(glm::mat4(1.f),glm::vec3(win_width*.5f,win_height*.5f,1.f))*mats[2]*mats[1]*mats[0];
+			if (spline_dirty or to_pixels!=spline_to_pixels) {
+				bezier_renderer.setPieces(spline.getPieces(),.5f,[&](const glm::vec3 &p) {
+					glm::vec4 c = to_pixels*glm::vec4(p,1.f);
+					return glm::vec2(c.x,c.y)/std::max(c.w,1e-3f);
+				});
+				spline_to_pixels = to_pixels; spline_dirty = false;
 			}
+			setMatrixes(bezier_renderer.getPiecesShader());
+			glPointSize(5);
+			if (show_spline) bezier_renderer.drawPiecesCurve();
+			if (show_poly) bezier_renderer.drawPiecesPoly();
 		}
 		
 		if (show_axis) {
 			shader_phong.use();
-			shader_phong.setLight(glm::vec4{-2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
 			setMatrixes(shader_phong);
 			glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
 			for(const Model &model : axis) {
 				shader_phong.setBuffers(model.buffers);
-				shader_phong.setMaterial(model.material);
+				shader_phong.setMaterial(model.material_index);
 				model.buffers.draw();
 			}
 		}
@@ -176,13 +207,14 @@ int main() {
 			ImGui::SliderFloat("T",&t,0.f,1.f);
 			if (ImGui::InputInt("Cant. Pts.",&cant_pts,1,1))
 				if (cant_pts<3) cant_pts=3;
+			Profiler::drawImGui();
 		});
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
 }
 
 void characterCallback(GLFWwindow* glfw_win, unsigned int code) {
@@ -215,6 +247,7 @@ void mouseMoveCallback(GLFWwindow* window, double xpos, double ypos) {
 	if (ctrl_pt==-1) common_callbacks::mouseMoveCallback(window,xpos,ypos);
 	else {
 		spline.setControlPoint(ctrl_pt,viewportToPlane(xpos,ypos));
+		spline_dirty = true;
 		if (ctrl_pt%degree==0) {
 			updateControlPointsAround(spline,ctrl_pt);
 			updateControlPointsAround(spline,ctrl_pt+degree);
@@ -239,3 +272,25 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 	if (ctrl_pt==-1) common_callbacks::mouseButtonCallback(window,button,action,mods);
 }
 
+
+// muestra el pez nadando, cada 120 cuadros arrastra uno de los puntos que
+// interpola la spline (en un crculo alrededor de su posicin, durante 60
+// cuadros), y cada 240 agrega o quita un tramo
+void benchmarkInput(GLFWwindow *window, int frame) {
+	static double x0, y0; // el punto arrastrado, en coords de la ventana
+	int f = frame%120;
+	if (frame==0) characterCallback(window,'p');
+	if (f==0) {
+		ctrl_pt = degree*(frame/120%(spline.getControlPointsCount()/degree));
+		auto ms = common_callbacks::getMatrixes(); // { model, view, projection }
+		glm::vec4 p = ms[2]*ms[1]*ms[0]*glm::vec4(spline.getControlPoint(ctrl_pt),1.f);
+		x0 = (p.x/p.w+1.f)/2.f*win_width; y0 = (1.f-p.y/p.w)/2.f*win_height;
+	}
+	if (f<60) {
+		double ang = f*2.0*3.14159265/60, r = .03*win_height;
+		mouseMoveCallback(window,x0+r*std::sin(ang),y0+r*(1-std::cos(ang)));
+	} else if (f==60) 
+		ctrl_pt = -1;
+	if (frame%480==239) characterCallback(window,'+');
+	if (frame%480==479) characterCallback(window,'-');
+}
@@ -6,10 +6,14 @@ BezierRenderer::BezierRenderer(int nsamples) : shader("shaders/curve") {
 	glBindVertexArray(VAO);
 	
 	v_curve.resize(nsamples);
+	t_curve.resize(nsamples);
+	for(int i=0;i<nsamples;++i)
+		t_curve[i] = float(i)/(nsamples-1);
 	v_poly.resize(4);
 	glGenBuffers(2, VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
 	glBufferData(GL_ARRAY_BUFFER, v_curve.size() * sizeof(glm::vec3), v_curve.data(), GL_DYNAMIC_DRAW);  
+	curve_capacity = v_curve.size();
 	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
 	glBufferData(GL_ARRAY_BUFFER, 4*sizeof(glm::vec3), v_poly.data(), GL_DYNAMIC_DRAW);  
 }
@@ -19,6 +23,18 @@ BezierRenderer::~BezierRenderer() {
 	glDeleteVertexArrays(1,&VAO);
 }
 
+void BezierRenderer::uploadBuffers() {
+	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
+	// the adaptive polylines may not fit in the buffer
+	if (v_curve.size()>curve_capacity) {
+		curve_capacity = v_curve.size();
+		glBufferData(GL_ARRAY_BUFFER, curve_capacity * sizeof(glm::vec3), v_curve.data(), GL_DYNAMIC_DRAW);
+	} else
+		glBufferSubData(GL_ARRAY_BUFFER, 0, v_curve.size() * sizeof(glm::vec3), v_curve.data());
+	glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, v_poly.size() * sizeof(glm::vec3), v_poly.data());
+}
+
 Shader &BezierRenderer::getShader() {
 	shader.use();
 	return shader;
@@ -46,6 +62,6 @@ void BezierRenderer::drawCurve() {
 	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(loc_pos);
 	shader.setUniform("color",color_curve);
-	glDrawArrays(GL_POINTS, 0,v_curve.size());
+	glDrawArrays(GL_LINE_STRIP, 0,v_curve.size());
 	glBindVertexArray(0);
 }
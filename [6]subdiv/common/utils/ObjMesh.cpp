@@ -5,6 +5,7 @@
 #include "ObjMesh.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
+#include "Profiler.hpp"
 #include <unordered_map>
 
 namespace {
@@ -81,6 +82,7 @@ std::map<std::string,Material> loadMaterialsLib(const std::string &path, const s
 }
 
 ObjMesh readObj(const std::string &full_path) {
+	PROFILE_FUNCTION();
 	cg_info( "Reading obj file: " + full_path + "..." );
 	std::string path = extractFolder(full_path);
 	std::ifstream file(full_path);
@@ -79,6 +79,9 @@ void Shader::load(const std::string &vertex_fname, const std::string &fragment_f
 	program_id = glCreateProgram();
 	glAttachShader(program_id,vertex_id);
 	glAttachShader(program_id,fragment_id);
+	glBindAttribLocation(program_id,aPosition,"vertexPosition");
+	glBindAttribLocation(program_id,aNormal,"vertexNormal");
+	glBindAttribLocation(program_id,aTexCoords,"vertexTexCoords");
 	glLinkProgram(program_id);
 	
 	GLint result = GL_FALSE, log_len = 0;
@@ -18,6 +18,11 @@ public:
 	void load(const std::string &fname);
 	void load(const std::string &vertex_fname, const std::string &fragment_fname);
 	
+	// fixed locations of the vertex attributes, bound before linking every
+	// program, so a VAO can be configured once for any of them (see
+	// SubDivMeshRenderer)
+	enum Attributes { aPosition=0, aNormal=1, aTexCoords=2 };
+	
 	bool setBuffer (const char *name, GLuint buffer_id, GLenum type, int size, bool required=true);
 	void setBuffers(const GeometryRenderer &geo);
 	void setMaterial(const Material &mat);
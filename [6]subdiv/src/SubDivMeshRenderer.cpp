@@ -6,8 +6,7 @@ SubDivMeshRenderer::SubDivMeshRenderer (const std::vector<glm::vec3> & pos,
 										const std::vector<int> & lines,
 										const std::vector<int> & tris) 
 {
-	glGenVertexArrays(1,&VAO);
-	glBindVertexArray(VAO);
+	glGenVertexArrays(2,VAO);
 	glGenBuffers(4, XBO);
 	
 	glBindBuffer(GL_ARRAY_BUFFER, XBO[0]);
@@ -17,14 +16,28 @@ SubDivMeshRenderer::SubDivMeshRenderer (const std::vector<glm::vec3> & pos,
 	glBufferData(GL_ARRAY_BUFFER, norms.size()*sizeof(glm::vec3), norms.data(), GL_STATIC_DRAW);
 	
 	npoints = pos.size();
+	nlines = lines.size();
+	ntris = tris.size();
 	
-	if ( (nlines=lines.size())!=0 ) {
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, XBO[2]);
+	// both VAOs share the attributes, each one has its own elements
+	for(int i=0;i<2;++i) {
+		glBindVertexArray(VAO[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, XBO[0]);
+		glVertexAttribPointer(Shader::aPosition, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(Shader::aPosition);
+		glBindBuffer(GL_ARRAY_BUFFER, XBO[1]);
+		glVertexAttribPointer(Shader::aNormal, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(Shader::aNormal);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, XBO[2+i]);
+	}
+	
+	if (nlines!=0) {
+		glBindVertexArray(VAO[0]);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, lines.size()*sizeof(int), lines.data(), GL_STATIC_DRAW);
 	}
 	
-	if ( (ntris=tris.size())!=0 ) {
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, XBO[3]);
+	if (ntris!=0) {
+		glBindVertexArray(VAO[1]);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, tris.size()*sizeof(int), tris.data(), GL_STATIC_DRAW);
 	}
 	
@@ -32,43 +45,32 @@ SubDivMeshRenderer::SubDivMeshRenderer (const std::vector<glm::vec3> & pos,
 	
 }
 
-void SubDivMeshRenderer::drawPoints(Shader &shader) const {
+void SubDivMeshRenderer::drawPoints() const {
 	if (ntris==0) return;
-	glBindVertexArray(VAO);
-	shader.setBuffer("vertexPosition",XBO[0],GL_FLOAT,3);
-	shader.setBuffer("vertexNormal",XBO[1],GL_FLOAT,3,false);
+	glBindVertexArray(VAO[0]);
 	glPointSize(3);
 	glDrawArrays(GL_POINTS,0,npoints);	
-	glBindVertexArray(0);
 }
 
-void SubDivMeshRenderer::drawLines(Shader &shader) const {
+void SubDivMeshRenderer::drawLines() const {
 	if (ntris==0) return;
-	glBindVertexArray(VAO);
-	shader.setBuffer("vertexPosition",XBO[0],GL_FLOAT,3);
-	shader.setBuffer("vertexNormal",XBO[1],GL_FLOAT,3,false);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, XBO[2]);
+	glBindVertexArray(VAO[0]);
 	glDrawElements(GL_LINES,nlines,GL_UNSIGNED_INT,0);	
-	glBindVertexArray(0);
 }
 
-void SubDivMeshRenderer::drawTriangles(Shader &shader) const {
+void SubDivMeshRenderer::drawTriangles() const {
 	if (ntris==0) return;
-	glBindVertexArray(VAO);
-	shader.setBuffer("vertexPosition",XBO[0],GL_FLOAT,3);
-	shader.setBuffer("vertexNormal",XBO[1],GL_FLOAT,3,false);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, XBO[3]);
+	glBindVertexArray(VAO[1]);
 	glPolygonOffset(1,1);
 	glEnable( GL_POLYGON_OFFSET_FILL );
 	glDrawElements(GL_TRIANGLES,ntris,GL_UNSIGNED_INT,0);	
 	glDisable( GL_POLYGON_OFFSET_FILL );
-	glBindVertexArray(0);
 }
 
 void SubDivMeshRenderer::freeResources( ) {
-	if (VAO==0) return;
+	if (VAO[0]==0) return;
 	glDeleteBuffers(4,XBO);
-	glDeleteVertexArrays(1,&VAO);
+	glDeleteVertexArrays(2,VAO);
 }
 SubDivMeshRenderer::~SubDivMeshRenderer ( ) {
 	freeResources();
@@ -13,16 +13,18 @@ public:
 					   const std::vector<int> &tris);
 	SubDivMeshRenderer(SubDivMeshRenderer &&o);
 	SubDivMeshRenderer &operator=(SubDivMeshRenderer &&o);
-	void drawPoints(Shader &shader) const;
-	void drawLines(Shader &shader) const;
-	void drawTriangles(Shader &shader) const;
+	// the VAOs are configured once, with the attributes in the Shader's fixed
+	// locations, so drawing only binds one of them (for any shader)
+	void drawPoints() const;
+	void drawLines() const;
+	void drawTriangles() const;
 	int GetNumberOfPoints() const { return npoints; }
 	~SubDivMeshRenderer();
 private:
 	void freeResources();
 	SubDivMeshRenderer(const SubDivMeshRenderer &) = delete;
 	SubDivMeshRenderer &operator=(const SubDivMeshRenderer &) = default;
-	GLuint VAO=0, XBO[4]; // XBO = { VBO_pos,VBO_normals,EBO_lines,EBO_triangles }
+	GLuint VAO[2]={0,0}, XBO[4]; // VAO = { lines,triangles }, XBO = { VBO_pos,VBO_normals,EBO_lines,EBO_triangles }
 	int npoints=0, nlines=0, ntris=0;
 };
 
@@ -13,6 +13,8 @@
 #include "Shaders.hpp"
 #include "SubDivMesh.hpp"
 #include "SubDivMeshRenderer.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20221013
 
@@ -25,10 +27,16 @@ bool fill = true, nodes = true, wireframe = true, smooth = false,
 // extraa callbacks
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
 
+// scripted inputs for the benchmark mode
+void benchmarkInput(GLFWwindow *window, int frame);
+
 SubDivMesh mesh;
 void subdivide(SubDivMesh &mesh);
 
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" runs a headless benchmark instead (see Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Demo",true);
@@ -54,6 +62,9 @@ int main() {
 	FrameTimer timer;
 	do {
 		
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(window,Benchmark::getFrame());
+		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
 		if (reload_mesh) {
@@ -61,6 +72,7 @@ int main() {
 			reload_mesh = false; mesh_modified = true;
 		}
 		if (mesh_modified) {
+			PROFILE_SCOPE("makeRenderer");
 			renderer = makeRenderer(mesh);
 			mesh_modified = false;
 		}
@@ -68,22 +80,23 @@ int main() {
 		if (nodes) {
 			shader_wireframe.use();
 			setMatrixes(shader_wireframe);
-			renderer.drawPoints(shader_wireframe);
+			renderer.drawPoints();
 		}
 		
 		if (wireframe) {
 			shader_wireframe.use();
 			setMatrixes(shader_wireframe);
-			renderer.drawLines(shader_wireframe);
+			renderer.drawLines();
 		}
 		
 		if (fill) {
+			PROFILE_GPU_SCOPE("fill");
 			Shader &shader = smooth ? shader_smooth : shader_flat;
 			shader.use();
 			setMatrixes(shader);
 			shader.setLight(glm::vec4{2.f,1.f,5.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.25f);
 			shader.setMaterial(material);
-			renderer.drawTriangles(shader);
+			renderer.drawTriangles();
 		}
 		
 		// settings sub-window
@@ -96,13 +109,14 @@ int main() {
 			if (ImGui::Button("Subdivide (D)")) { subdivide(mesh); mesh_modified = true; }
 			if (ImGui::Button("Reset (R)")) reload_mesh = true;
 			ImGui::Text("Nodes: %i, Elements: %i",mesh.n.size(),mesh.e.size());
+			Profiler::drawImGui();
 		});
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
 }
 
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods) {
@@ -119,6 +133,16 @@ void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, i
 	}
 }
 
+// every model, subdivided three times (one every 40 frames) with flat and
+// smooth shading, rotating
+void benchmarkInput(GLFWwindow *window, int frame) {
+	model_angle += static_cast<float>(Benchmark::getTimeStep());
+	int f = frame%200;
+	if (f==40 or f==80 or f==120) keyboardCallback(window,'D',0,GLFW_PRESS,0);
+	if (f==100 or f==140) keyboardCallback(window,'S',0,GLFW_PRESS,0);
+	if (f==199) keyboardCallback(window,'O',0,GLFW_PRESS,0);
+}
+
 // La struct Arista guarda los dos indices de nodos de una arista
 // Siempre pone primero el menor indice, para facilitar la bsqueda en lista ordenada;
 //    es para usar con el Mapa de ms abajo, para asociar un nodo nuevo a una arista vieja
@@ -138,6 +162,7 @@ struct Arista {
 };
 
 void subdivide(SubDivMesh &mesh) {
+	PROFILE_FUNCTION();
 	
 	/// @@@@@: Implementar Catmull-Clark... lineamientos:
 	
@@ -0,0 +1,18 @@
+// table with the properties of all the materials (see MaterialTable in 
+// Shaders.hpp), in a std140 uniform block shared by all the programs; each
+// draw only sets the index of its material
+
+struct MaterialData {
+	vec3 ambientColor;
+	float opacity;
+	vec3 diffuseColor;
+	float shininess;
+	vec3 specularColor;
+	vec3 emissionColor;
+};
+
+layout(std140) uniform Materials {
+	MaterialData materials[256];
+};
+
+uniform int materialIndex;
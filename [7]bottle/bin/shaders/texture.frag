@@ -7,27 +7,22 @@ in vec4 lightVSPosition;
 
 // propiedades del material
 uniform sampler2D colorTexture;
-uniform vec3 ambientColor;
-uniform vec3 specularColor;
-uniform vec3 diffuseColor;
-uniform vec3 emissionColor;
-uniform float opacity;
-uniform float shininess;
+#include "funcs/materials.glsl"
 
 // propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+#include "funcs/frameData.glsl"
 
 out vec4 fragColor;
 
 #include "funcs/calcPhong.frag"
 
 void main() {
+	MaterialData material = materials[materialIndex];
 	vec4 tex = texture(colorTexture,fragTexCoords);
 	vec3 phong = calcPhong(lightVSPosition, lightColor,
-						   mix(ambientColor,vec3(tex),tex.a),
-						   mix(diffuseColor,vec3(tex),tex.a),
-						   specularColor, shininess);
-	fragColor = vec4(phong+emissionColor,opacity);
+						   mix(material.ambientColor,vec3(tex),tex.a),
+						   mix(material.diffuseColor,vec3(tex),tex.a),
+						   material.specularColor, material.shininess);
+	fragColor = vec4(phong+material.emissionColor,material.opacity);
 }
 
@@ -0,0 +1,42 @@
+#ifndef ASSETCACHE_HPP
+#define ASSETCACHE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "Model.hpp"
+#include "Texture.hpp"
+#include "Shaders.hpp"
+
+// shared models, textures and shaders, so the same file (with the same flags)
+// is loaded only once; the handles are reference counted, and the cache keeps
+// one more reference to each asset, so they survive after the last user lets
+// them go (going back to a model is then instant); when the memory used in the
+// GPU by the cached assets exceeds the budget, the least recently requested
+// ones that nobody else is using are released
+class AssetCache {
+public:
+	using ModelsHandle = std::shared_ptr<const std::vector<Model>>;
+	using TextureHandle = std::shared_ptr<const Texture>;
+	using ShaderHandle = std::shared_ptr<Shader>;
+
+	// same arguments as Model::load (fDynamic is not allowed, since the
+	// buffers of a shared model can not be modified)
+	static ModelsHandle models(const std::string &name, int flags = 0);
+	// the textures are loaded asynchronously (see TextureLoader::update)
+	static TextureHandle texture(const std::string &fname, bool repeat_s=true, bool repeat_t=true);
+	static ShaderHandle shader(const std::string &fname);
+	static ShaderHandle shader(const std::string &vertex_fname, const std::string &fragment_fname);
+
+	static void setBudget(size_t bytes);
+	static size_t getBudget();
+	// bytes used in the GPU by all the cached assets (in use or not)
+	static size_t memoryUsage();
+	// releases the cached assets that are not in use (all of them must be
+	// released before destroying the OpenGL context; the destructor of the
+	// last Window calls it, so the handles must be gone by then)
+	static void clear();
+};
+
+#endif
+
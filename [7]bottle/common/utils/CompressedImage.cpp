@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stb_image.h>
+#include "CompressedImage.hpp"
+#include "Debug.hpp"
+#include "Misc.hpp"
+
+namespace {
+
+const char image_magic[4] = {'C','G','T','X'};
+const uint32_t image_version = 1;
+
+std::string getCompressedPath(const std::string &image_path) {
+	return image_path+".ctex";
+}
+
+// box filter, an odd row/column is merged with the previous one
+std::vector<unsigned char> halve(const unsigned char *src, int w, int h) {
+	int nw = std::max(1,w/2), nh = std::max(1,h/2);
+	std::vector<unsigned char> dst(size_t(nw)*nh*4);
+	for(int y=0;y<nh;++y) {
+		int y0 = std::min(2*y,h-1), y1 = std::min(2*y+1,h-1);
+		for(int x=0;x<nw;++x) {
+			int x0 = std::min(2*x,w-1), x1 = std::min(2*x+1,w-1);
+			for(int c=0;c<4;++c) {
+				int sum = src[(size_t(y0)*w+x0)*4+c] + src[(size_t(y0)*w+x1)*4+c]
+						+ src[(size_t(y1)*w+x0)*4+c] + src[(size_t(y1)*w+x1)*4+c];
+				dst[(size_t(y)*nw+x)*4+c] = static_cast<unsigned char>((sum+2)/4);
+			}
+		}
+	}
+	return dst;
+}
+
+// --- block encoding ---
+
+struct Color { float r, g, b; };
+
+uint16_t to565(const Color &c) {
+	auto q = [](float v, int max) { return static_cast<int>(std::min(std::max(v,0.f),255.f)*max/255.f+.5f); };
+	return static_cast<uint16_t>((q(c.r,31)<<11)|(q(c.g,63)<<5)|q(c.b,31));
+}
+
+Color from565(uint16_t c) {
+	int r = (c>>11)&31, g = (c>>5)&63, b = c&31;
+	return { float((r<<3)|(r>>2)), float((g<<2)|(g>>4)), float((b<<3)|(b>>2)) };
+}
+
+void put16(unsigned char *p, uint16_t v) { p[0] = v&0xFF; p[1] = v>>8; }
+
+// the endpoints are the extremes of the pixels along their principal axis
+// (from a few power iterations over the covariance matrix), and each pixel
+// takes the nearest of the 4 colors of the palette
+void encodeColors(const unsigned char px[16][4], unsigned char *out) {
+	Color mean = {0,0,0};
+	for(int i=0;i<16;++i) { mean.r += px[i][0]; mean.g += px[i][1]; mean.b += px[i][2]; }
+	mean.r /= 16; mean.g /= 16; mean.b /= 16;
+	float cov[6] = {0,0,0,0,0,0}; // rr rg rb gg gb bb
+	for(int i=0;i<16;++i) {
+		float r = px[i][0]-mean.r, g = px[i][1]-mean.g, b = px[i][2]-mean.b;
+		cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+		cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+	}
+	Color axis = {1,1,1};
+	for(int it=0;it<4;++it) {
+		Color a = { cov[0]*axis.r+cov[1]*axis.g+cov[2]*axis.b,
+					cov[1]*axis.r+cov[3]*axis.g+cov[4]*axis.b,
+					cov[2]*axis.r+cov[4]*axis.g+cov[5]*axis.b };
+		float m = std::max(std::max(std::abs(a.r),std::abs(a.g)),std::abs(a.b));
+		if (m==0.f) break;
+		axis = { a.r/m, a.g/m, a.b/m };
+	}
+	float tmin = 0.f, tmax = 0.f, len2 = axis.r*axis.r+axis.g*axis.g+axis.b*axis.b;
+	for(int i=0;i<16;++i) {
+		float t = ((px[i][0]-mean.r)*axis.r+(px[i][1]-mean.g)*axis.g+(px[i][2]-mean.b)*axis.b)/len2;
+		tmin = std::min(tmin,t); tmax = std::max(tmax,t);
+	}
+	uint16_t c0 = to565({mean.r+axis.r*tmax,mean.g+axis.g*tmax,mean.b+axis.b*tmax});
+	uint16_t c1 = to565({mean.r+axis.r*tmin,mean.g+axis.g*tmin,mean.b+axis.b*tmin});
+	if (c0<c1) std::swap(c0,c1); // c0>c1 selects the 4 colors mode in BC1
+	put16(out,c0); put16(out+2,c1);
+	uint32_t indices = 0;
+	if (c0!=c1) {
+		Color p[4] = { from565(c0), from565(c1) };
+		p[2] = { (2*p[0].r+p[1].r)/3, (2*p[0].g+p[1].g)/3, (2*p[0].b+p[1].b)/3 };
+		p[3] = { (p[0].r+2*p[1].r)/3, (p[0].g+2*p[1].g)/3, (p[0].b+2*p[1].b)/3 };
+		for(int i=0;i<16;++i) {
+			int best = 0; float best_d = 1e9f;
+			for(int j=0;j<4;++j) {
+				float dr = px[i][0]-p[j].r, dg = px[i][1]-p[j].g, db = px[i][2]-p[j].b;
+				float d = dr*dr+dg*dg+db*db;
+				if (d<best_d) { best_d = d; best = j; }
+			}
+			indices |= uint32_t(best)<<(2*i);
+		}
+	}
+	for(int i=0;i<4;++i) out[4+i] = (indices>>(8*i))&0xFF;
+}
+
+// 8 alphas mode: the extremes, and 6 values interpolated between them
+void encodeAlpha(const unsigned char px[16][4], unsigned char *out) {
+	int a0 = 0, a1 = 255;
+	for(int i=0;i<16;++i) { a0 = std::max<int>(a0,px[i][3]); a1 = std::min<int>(a1,px[i][3]); }
+	out[0] = a0; out[1] = a1;
+	uint64_t indices = 0;
+	if (a0!=a1) {
+		int pal[8] = { a0, a1 };
+		for(int j=2;j<8;++j) pal[j] = ((8-j)*a0+(j-1)*a1)/7;
+		for(int i=0;i<16;++i) {
+			int best = 0;
+			for(int j=1;j<8;++j)
+				if (std::abs(px[i][3]-pal[j])<std::abs(px[i][3]-pal[best])) best = j;
+			indices |= uint64_t(best)<<(3*i);
+		}
+	}
+	for(int i=0;i<6;++i) out[2+i] = (indices>>(8*i))&0xFF;
+}
+
+// returns an empty vector if stop returns true (it is checked once per row
+// of blocks)
+std::vector<unsigned char> compressLevel(const unsigned char *rgba, int w, int h, GLenum format,
+										 const std::function<bool()> &stop) 
+{
+	int bw = (w+3)/4, bh = (h+3)/4, block_size = CompressedImage::blockSize(format);
+	std::vector<unsigned char> out(size_t(bw)*bh*block_size);
+	unsigned char px[16][4];
+	for(int by=0;by<bh;++by) {
+		if (stop and stop()) return {};
+		for(int bx=0;bx<bw;++bx) {
+			for(int i=0;i<16;++i) { // the pixels out of the image repeat the border
+				int x = std::min(bx*4+i%4,w-1), y = std::min(by*4+i/4,h-1);
+				std::memcpy(px[i],&rgba[(size_t(y)*w+x)*4],4);
+			}
+			unsigned char *block = &out[(size_t(by)*bw+bx)*block_size];
+			if (format==GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+				encodeAlpha(px,block);
+				encodeColors(px,block+8);
+			} else
+				encodeColors(px,block);
+		}
+	}
+	return out;
+}
+
+}
+
+std::vector<std::vector<unsigned char>> buildMipmaps(const unsigned char *rgba, int width, int height) {
+	std::vector<std::vector<unsigned char>> levels;
+	levels.emplace_back(rgba,rgba+size_t(width)*height*4);
+	for(int w=width,h=height; w>1 or h>1; w=std::max(1,w/2),h=std::max(1,h/2))
+		levels.push_back(halve(levels.back().data(),w,h));
+	return levels;
+}
+
+CompressedImage compressImage(const unsigned char *rgba, int width, int height, const std::function<bool()> &stop) {
+	CompressedImage image;
+	image.width = width; image.height = height;
+	bool opaque = true;
+	for(size_t i=3,n=size_t(width)*height*4;i<n and opaque;i+=4)
+		opaque = rgba[i]==255;
+	image.format = opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	// the same levels as buildMipmaps, but only the previous one is kept
+	std::vector<unsigned char> level;
+	for(int w=width,h=height;;w=std::max(1,w/2),h=std::max(1,h/2)) {
+		const unsigned char *src = level.empty() ? rgba : level.data();
+		image.levels.push_back(compressLevel(src,w,h,image.format,stop));
+		if (image.levels.back().empty()) { image.levels.clear(); break; }
+		if (w==1 and h==1) break;
+		level = halve(src,w,h);
+	}
+	return image;
+}
+
+bool readCompressedImage(const std::string &image_path, CompressedImage &image, bool header_only) {
+	std::ifstream file(getCompressedPath(image_path),std::ios::binary);
+	if (not file.is_open()) return false;
+	auto get = [&](void *dst, size_t n) { return static_cast<bool>(file.read(static_cast<char*>(dst),n)); };
+	char magic[4]; uint32_t version, format, nlevels;
+	long long mtime, size, cur_mtime, cur_size;
+	int32_t width, height;
+	if (not get(magic,4) or std::memcmp(magic,image_magic,4)!=0 or
+		not get(&version,sizeof(version)) or version!=image_version) return false;
+	// the original image, it must not have changed
+	if (not get(&mtime,sizeof(mtime)) or not get(&size,sizeof(size)) or
+		not getFileStamp(image_path,cur_mtime,cur_size) or cur_mtime!=mtime or cur_size!=size) return false;
+	if (not get(&format,sizeof(format)) or not get(&width,sizeof(width)) or
+		not get(&height,sizeof(height)) or not get(&nlevels,sizeof(nlevels))) return false;
+	CompressedImage aux;
+	aux.format = format; aux.width = width; aux.height = height;
+	if (not header_only) {
+		aux.levels.resize(nlevels);
+		for(std::vector<unsigned char> &level : aux.levels) {
+			uint32_t n;
+			if (not get(&n,sizeof(n))) break;
+			level.resize(n);
+			if (not get(level.data(),n)) break;
+		}
+		if (not file or file.peek()!=EOF) {
+			cg_info("Ignoring corrupt compressed image: " + getCompressedPath(image_path));
+			return false;
+		}
+	}
+	image = std::move(aux);
+	return true;
+}
+
+bool writeCompressedImage(const std::string &image_path, const CompressedImage &image) {
+	// written with another name and then renamed, so another worker loading
+	// the same image (see TextureLoader) never reads a partially written file
+	std::string path = getCompressedPath(image_path), tmp_path = getTempFileName(path);
+	std::ofstream file(tmp_path,std::ios::binary|std::ios::trunc);
+	if (not file.is_open()) return false;
+	auto put = [&](const void *src, size_t n) { file.write(static_cast<const char*>(src),n); };
+	long long mtime = 0, size = 0;
+	getFileStamp(image_path,mtime,size);
+	uint32_t format = image.format, nlevels = image.levels.size();
+	int32_t width = image.width, height = image.height;
+	put(image_magic,4); put(&image_version,sizeof(image_version));
+	put(&mtime,sizeof(mtime)); put(&size,sizeof(size));
+	put(&format,sizeof(format)); put(&width,sizeof(width));
+	put(&height,sizeof(height)); put(&nlevels,sizeof(nlevels));
+	for(const std::vector<unsigned char> &level : image.levels) {
+		uint32_t n = level.size();
+		put(&n,sizeof(n)); put(level.data(),n);
+	}
+	file.close();
+	if (not file.good()) {
+		std::remove(tmp_path.c_str());
+		return false;
+	}
+	return replaceFile(tmp_path,path);
+}
+
+bool convertImage(const std::string &image_path) {
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load(true); // same as Texture
+	unsigned char *data = stbi_load(image_path.c_str(), &width, &height, &channels, 4);
+	if (not data) return false;
+	CompressedImage image = compressImage(data,width,height);
+	stbi_image_free(data);
+	return writeCompressedImage(image_path,image);
+}
+
@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+#include <cstddef>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const std::string &fname);
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+	~MappedFile();
+	bool isOk() const { return data_ptr!=nullptr; }
+	const char *data() const { return data_ptr; }
+	const char *begin() const { return data_ptr; }
+	const char *end() const { return data_ptr+data_size; }
+	size_t size() const { return data_size; }
+private:
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = default;
+	void freeResources();
+	const char *data_ptr = nullptr;
+	size_t data_size = 0;
+#ifdef _WIN32
+	void *file_handle = nullptr, *map_handle = nullptr;
+#endif
+};
+
+#endif
+
@@ -7,17 +7,31 @@
 class Texture {
 public:
 	Texture() = default;
-	Texture(const std::string &fname, bool repeat_s=true, bool repeat_t=true);
+	// with async=true the image is decoded and uploaded in background (see
+	// TextureLoader), and meanwhile the texture shows a placeholder (its
+	// smallest mipmap levels, once they are there)
+	Texture(const std::string &fname, bool repeat_s=true, bool repeat_t=true, bool async=false);
+	// from RGBA pixels already in memory (from the bottom row, as the files
+	// are loaded), for instance an atlas (see TextureAtlas); it has no mipmaps
+	// (in the smaller levels of an atlas the images would bleed into each other)
+	Texture(const unsigned char *rgba, int width, int height, bool repeat_s=true, bool repeat_t=true);
 	Texture(Texture &&t);
 	Texture &operator=(Texture &&t);
 	~Texture();
 	void bind(int number=0) const;
 	bool isOk() const { return channels!=-1; }
+	// false while an async texture is still loading
+	bool isResident() const;
+	// bytes used in the GPU (RGBA8 or block compressed, plus its mipmaps)
+	size_t memorySize() const { return isOk() ? size_t(width)*height*bits_per_pixel/8*(mipmaps?4:3)/3 : 0; }
 private:
 	Texture &operator=(const Texture &t) = default;
+	void freeResources();
 	GLuint id = 0;
 	int width=-1, height=-1, channels=-1;
+	int bits_per_pixel = 32;
 	bool repeat_s=true, repeat_t=true;
+	bool mipmaps = true;
 };
 
 #endif
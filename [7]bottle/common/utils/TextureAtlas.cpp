@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include "TextureAtlas.hpp"
+#include "Debug.hpp"
+
+SkylinePacker::SkylinePacker(int width, int height) : width(width), height(height) {
+	skyline.push_back({0,0,width});
+}
+
+int SkylinePacker::fitAt(size_t i, int w, int h) const {
+	if (skyline[i].x+w>width) return -1;
+	int y = 0;
+	for(int left=w; left>0; left-=skyline[i++].width) {
+		y = std::max(y,skyline[i].y);
+		if (y+h>height) return -1;
+	}
+	return y;
+}
+
+bool SkylinePacker::insert(int w, int h, int &x, int &y) {
+	int best = -1, best_y = 0;
+	for(size_t i=0;i<skyline.size();++i) {
+		int fy = fitAt(i,w,h);
+		if (fy!=-1 and (best==-1 or fy<best_y)) { best = i; best_y = fy; }
+	}
+	if (best==-1) return false;
+	x = skyline[best].x; y = best_y;
+	// the segments under the new rectangle are replaced by its top
+	for(size_t i=best; i<skyline.size() and skyline[i].x<x+w; ) {
+		int end = skyline[i].x+skyline[i].width;
+		if (end>x+w) { skyline[i].x = x+w; skyline[i].width = end-x-w; break; }
+		skyline.erase(skyline.begin()+i);
+	}
+	skyline.insert(skyline.begin()+best,{x,y+h,w});
+	for(size_t i=0;i+1<skyline.size();) {
+		if (skyline[i].y==skyline[i+1].y) {
+			skyline[i].width += skyline[i+1].width;
+			skyline.erase(skyline.begin()+i+1);
+		} else
+			++i;
+	}
+	return true;
+}
+
+namespace {
+
+struct Image {
+	int width = 0, height = 0;
+	std::vector<unsigned char> pixels; // RGBA, from the bottom row (as Texture loads them)
+	bool repeat_s = true, repeat_t = true;
+	int x = 0, y = 0; // in the atlas (without the padding)
+};
+
+using EdgeVertexes = std::map<std::tuple<int,int,int>,int>;
+
+// the vertex in the edge a-b where tex_coords[axis]==line (the same one for
+// both triangles that share the edge, so there are no cracks)
+int splitEdge(Geometry &geo, EdgeVertexes &cache, int a, int b, int axis, int line) {
+	if (a>b) std::swap(a,b);
+	auto key = std::make_tuple(a,b,2*line+axis);
+	auto it = cache.find(key);
+	if (it!=cache.end()) return it->second;
+	float t = (line-geo.tex_coords[a][axis])/(geo.tex_coords[b][axis]-geo.tex_coords[a][axis]);
+	glm::vec3 p = glm::mix(geo.positions[a],geo.positions[b],t);
+	geo.positions.push_back(p);
+	if (not geo.normals.empty()) {
+		glm::vec3 n = glm::normalize(glm::mix(geo.normals[a],geo.normals[b],t));
+		geo.normals.push_back(n);
+	}
+	glm::vec2 tc = glm::mix(geo.tex_coords[a],geo.tex_coords[b],t);
+	tc[axis] = float(line);
+	geo.tex_coords.push_back(tc);
+	return cache[key] = geo.positions.size()-1;
+}
+
+// splits the triangles that cross the lines where tex_coords[axis] is an
+// integer (if it repeats), or only the lines 0 and 1 (if not)
+void splitTriangles(Geometry &geo, int axis, bool repeat) {
+	EdgeVertexes cache;
+	std::vector<int> pending = geo.triangles, result;
+	while (not pending.empty()) {
+		int v[3] = { pending[pending.size()-3], pending[pending.size()-2], pending.back() };
+		pending.resize(pending.size()-3);
+		float c[3] = { geo.tex_coords[v[0]][axis], geo.tex_coords[v[1]][axis], geo.tex_coords[v[2]][axis] };
+		float lo = std::min({c[0],c[1],c[2]}), hi = std::max({c[0],c[1],c[2]});
+		// the first line strictly inside the triangle
+		int line = repeat ? int(std::floor(lo))+1 : (lo<0.f ? 0 : 1);
+		if (not (line>lo and line<hi)) {
+			result.insert(result.end(),v,v+3);
+			continue;
+		}
+		// the polygons at each side of the line (in the same order as the
+		// triangle, to keep its orientation), as fans of triangles to split again
+		std::vector<int> below, above;
+		for(int k=0;k<3;++k) {
+			int a = v[k], b = v[(k+1)%3];
+			float ca = c[k], cb = c[(k+1)%3];
+			if (ca<=line) below.push_back(a);
+			if (ca>=line) above.push_back(a);
+			if ((ca<line and cb>line) or (ca>line and cb<line)) {
+				int m = splitEdge(geo,cache,a,b,axis,line);
+				below.push_back(m); above.push_back(m);
+			}
+		}
+		for(const std::vector<int> *poly : {&below,&above})
+			for(size_t k=1;k+1<poly->size();++k)
+				pending.insert(pending.end(),{(*poly)[0],(*poly)[k],(*poly)[k+1]});
+	}
+	geo.triangles = std::move(result);
+}
+
+// moves each triangle to the period [0,1] of the axes that repeat, and then
+// into the image's rectangle in the atlas; the triangles out of a clamped
+// image (and all of them if there is no image) go to the transparent area
+// (empty_tc); a vertex shared by triangles that end up in different places
+// is duplicated
+void remapTexCoords(Geometry &geo, const Image &img, const glm::vec2 &atlas_size, const glm::vec2 &empty_tc) {
+	Geometry out;
+	std::map<std::tuple<int,int,int>,int> copies; // (vertex, period in s, period in t) -> new vertex
+	for(size_t i=0;i<geo.triangles.size();i+=3) {
+		glm::vec2 center = (geo.tex_coords[geo.triangles[i]]+geo.tex_coords[geo.triangles[i+1]]
+							+geo.tex_coords[geo.triangles[i+2]])/3.f;
+		glm::vec2 period(img.repeat_s ? std::floor(center.x) : 0.f, img.repeat_t ? std::floor(center.y) : 0.f);
+		bool outside = img.pixels.empty() or
+			(not img.repeat_s and (center.x<0.f or center.x>1.f)) or
+			(not img.repeat_t and (center.y<0.f or center.y>1.f));
+		for(int k=0;k<3;++k) {
+			int v = geo.triangles[i+k];
+			auto key = outside ? std::make_tuple(v,INT_MIN,INT_MIN) : std::make_tuple(v,int(period.x),int(period.y));
+			auto it = copies.find(key);
+			if (it==copies.end()) {
+				glm::vec2 tc = empty_tc;
+				if (not outside) {
+					glm::vec2 local = glm::clamp(geo.tex_coords[v]-period,0.f,1.f);
+					tc = (glm::vec2(img.x,img.y)+local*glm::vec2(img.width,img.height))/atlas_size;
+				}
+				out.positions.push_back(geo.positions[v]);
+				if (not geo.normals.empty()) out.normals.push_back(geo.normals[v]);
+				out.tex_coords.push_back(tc);
+				it = copies.insert({key,int(out.positions.size())-1}).first;
+			}
+			out.triangles.push_back(it->second);
+		}
+	}
+	geo = std::move(out);
+}
+
+}
+
+std::shared_ptr<const Texture> buildAtlas(std::vector<Model> &models, const std::vector<AtlasImage> &images, int padding) {
+	cg_assert(models.size()==images.size(),"buildAtlas needs an image for each model");
+	std::vector<Image> imgs(images.size());
+	stbi_set_flip_vertically_on_load(true); // same as Texture
+	for(size_t i=0;i<images.size();++i) {
+		imgs[i].repeat_s = images[i].repeat_s; imgs[i].repeat_t = images[i].repeat_t;
+		if (images[i].fname.empty()) continue;
+		int channels;
+		unsigned char *data = stbi_load(images[i].fname.c_str(), &imgs[i].width, &imgs[i].height, &channels, 4);
+		cg_assert(data,"Could not load texture "+images[i].fname);
+		imgs[i].pixels.assign(data,data+size_t(imgs[i].width)*imgs[i].height*4);
+		stbi_image_free(data);
+	}
+
+	// the rectangles (each image with its padding, and a transparent one), from
+	// the tallest to the shortest, in the smallest power of 2 sizes where they fit
+	std::vector<int> order; // the transparent one is imgs.size()
+	int area = 0, empty_size = std::max(2,2*padding);
+	for(size_t i=0;i<=imgs.size();++i) {
+		if (i<imgs.size() and imgs[i].pixels.empty()) continue;
+		order.push_back(i);
+		area += i<imgs.size() ? (imgs[i].width+2*padding)*(imgs[i].height+2*padding) : empty_size*empty_size;
+	}
+	auto rectHeight = [&](int i) { return i<int(imgs.size()) ? imgs[i].height+2*padding : empty_size; };
+	auto rectWidth = [&](int i) { return i<int(imgs.size()) ? imgs[i].width+2*padding : empty_size; };
+	std::stable_sort(order.begin(),order.end(),[&](int a, int b) { return rectHeight(a)>rectHeight(b); });
+	int max_size; glGetIntegerv(GL_MAX_TEXTURE_SIZE,&max_size);
+	int width = 1, height = 1, empty_x = 0, empty_y = 0;
+	while (width*height<area) (width<=height ? width : height) *= 2;
+	for(;;) {
+		cg_assert(width<=max_size and height<=max_size,"The atlas is too big");
+		SkylinePacker packer(width,height);
+		bool done = true;
+		for(int i : order) {
+			int x, y;
+			if (not packer.insert(rectWidth(i),rectHeight(i),x,y)) { done = false; break; }
+			if (i<int(imgs.size())) { imgs[i].x = x+padding; imgs[i].y = y+padding; }
+			else { empty_x = x; empty_y = y; }
+		}
+		if (done) break;
+		(width<=height ? width : height) *= 2;
+	}
+
+	// the images and their borders: the opposite side of the image where it
+	// repeats, or transparent (as the whole atlas starts) where it does not
+	std::vector<unsigned char> atlas(size_t(width)*height*4,0);
+	for(const Image &img : imgs) {
+		if (img.pixels.empty()) continue;
+		for(int y=-padding;y<img.height+padding;++y) {
+			int sy = y;
+			if (sy<0 or sy>=img.height) { if (not img.repeat_t) continue; sy = (sy%img.height+img.height)%img.height; }
+			for(int x=-padding;x<img.width+padding;++x) {
+				int sx = x;
+				if (sx<0 or sx>=img.width) { if (not img.repeat_s) continue; sx = (sx%img.width+img.width)%img.width; }
+				std::memcpy(&atlas[(size_t(img.y+y)*width+img.x+x)*4],&img.pixels[(size_t(sy)*img.width+sx)*4],4);
+			}
+		}
+	}
+	auto texture = std::make_shared<const Texture>(atlas.data(),width,height,false,false);
+
+	glm::vec2 atlas_size(width,height);
+	glm::vec2 empty_tc = (glm::vec2(empty_x,empty_y)+.5f*empty_size)/atlas_size;
+	for(size_t i=0;i<models.size();++i) {
+		Geometry &geo = models[i].geometry;
+		cg_assert(not geo.positions.empty(),"buildAtlas needs the geometry of the models (fKeepGeometry)");
+		if (geo.triangles.empty())
+			for(size_t v=0;v<geo.positions.size();++v) geo.triangles.push_back(v);
+		geo.tex_coords.resize(geo.positions.size());
+		if (not imgs[i].pixels.empty()) {
+			splitTriangles(geo,0,imgs[i].repeat_s);
+			splitTriangles(geo,1,imgs[i].repeat_t);
+		}
+		remapTexCoords(geo,imgs[i],atlas_size,empty_tc);
+		models[i].buffers = GeometryRenderer(geo);
+		models[i].lods.clear();
+		models[i].texture = texture;
+	}
+	return texture;
+}
+
+std::shared_ptr<const Texture> buildAtlas(std::vector<Model> &models, int padding) {
+	std::vector<AtlasImage> images(models.size());
+	for(size_t i=0;i<models.size();++i)
+		images[i].fname = models[i].material.texture;
+	return buildAtlas(models,images,padding);
+}
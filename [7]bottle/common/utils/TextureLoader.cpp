@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stb_image.h>
+#include "TextureLoader.hpp"
+#include "CompressedImage.hpp"
+#include "Benchmark.hpp"
+#include "Debug.hpp"
+
+namespace {
+
+struct Job {
+	GLuint texture_id;
+	std::string fname;
+	int width, height;
+	GLenum format; // GL_RGBA, or the format of the compressed file
+	// set by the worker (under the loader's mutex)
+	bool decoded = false, cancelled = false;
+	std::string error;
+	std::vector<std::vector<unsigned char>> levels; // RGBA, level 0 first
+	// main thread only, next level to upload (from the last one to 0), and
+	// its next row (the large levels are sent in several parts)
+	int next_level = -1, next_row = 0;
+	// pixels per row (a row of blocks for compressed images), and bytes per row
+	int rowHeight() const { return format==GL_RGBA ? 1 : 4; }
+	size_t rowSize(int level) const {
+		int w = std::max(1,width>>level);
+		if (format==GL_RGBA) return size_t(w)*4;
+		return size_t((w+3)/4)*CompressedImage::blockSize(format);
+	}
+	int rowsCount(int level) const {
+		return (std::max(1,height>>level)+rowHeight()-1)/rowHeight();
+	}
+};
+
+struct Loader {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::condition_variable decoded_cv; // a worker finished a job
+	std::deque<std::shared_ptr<Job>> queue; // waiting for a worker
+	std::vector<std::shared_ptr<Job>> pending; // requested and not fully uploaded yet
+	std::vector<std::thread> workers;
+	bool quit = false;
+	GLuint pbo = 0;
+	~Loader() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		cv.notify_all();
+		for(std::thread &t : workers) t.join();
+	}
+};
+
+Loader &getLoader() {
+	static Loader loader;
+	return loader;
+}
+
+// for an image that was not compressed, rgba gets its decoded pixels (level
+// 0), that the caller must release with stbi_image_free
+void decode(Job &job, std::vector<std::vector<unsigned char>> &levels, std::string &error, unsigned char *&rgba) {
+	if (job.format!=GL_RGBA) { // already compressed, with its mipmaps
+		CompressedImage image;
+		if (not readCompressedImage(job.fname,image) or image.format!=job.format or
+			image.width!=job.width or image.height!=job.height or
+			int(image.levels.size())!=TextureLoader::levelsCount(job.width,job.height))
+			error = "Texture "+job.fname+" changed while loading";
+		else
+			levels = std::move(image.levels);
+		return;
+	}
+	int w, h, channels;
+	unsigned char *data = stbi_load(job.fname.c_str(), &w, &h, &channels, 4);
+	if (not data) { error = "Could not load texture "+job.fname; return; }
+	if (w!=job.width or h!=job.height) {
+		error = "Texture "+job.fname+" changed while loading";
+		stbi_image_free(data);
+	} else {
+		levels = buildMipmaps(data,w,h);
+		rgba = data;
+	}
+}
+
+void work(Loader &loader) {
+	for(;;) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(loader.mutex);
+			loader.cv.wait(lock,[&]() { return loader.quit or not loader.queue.empty(); });
+			if (loader.quit) return;
+			job = loader.queue.front();
+			loader.queue.pop_front();
+		}
+		std::vector<std::vector<unsigned char>> levels;
+		std::string error;
+		unsigned char *rgba = nullptr;
+		decode(*job,levels,error,rgba);
+		bool cancelled;
+		{
+			std::lock_guard<std::mutex> lock(loader.mutex);
+			cancelled = job->cancelled;
+			if (not cancelled) {
+				job->levels = std::move(levels);
+				job->error = std::move(error);
+				job->decoded = true;
+			}
+		}
+		loader.decoded_cv.notify_all();
+		// if it was not compressed, the compressed file is generated for the
+		// next time, after giving the levels to the main thread (from the
+		// decoded pixels, so they are not copied); it is abandoned if the
+		// program is closing
+		if (rgba and not cancelled and GLAD_GL_EXT_texture_compression_s3tc) {
+			auto quitting = [&]() { std::lock_guard<std::mutex> lock(loader.mutex); return loader.quit; };
+			CompressedImage image = compressImage(rgba,job->width,job->height,quitting);
+			if (not image.levels.empty() and not writeCompressedImage(job->fname,image))
+				cg_info("Could not write compressed texture for: " + job->fname);
+		}
+		stbi_image_free(rgba);
+	}
+}
+
+// copies some rows of a level to the pixel unpack buffer and from there to
+// the texture
+void upload(Loader &loader, const Job &job, int level, int row, int rows) {
+	int width = std::max(1,job.width>>level), height = std::max(1,job.height>>level);
+	int y = row*job.rowHeight(), h = std::min(rows*job.rowHeight(),height-y);
+	size_t size = job.rowSize(level)*rows;
+	if (loader.pbo==0) glGenBuffers(1,&loader.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,loader.pbo);
+	// orphans the previous contents, so it does not wait for the previous transfer
+	glBufferData(GL_PIXEL_UNPACK_BUFFER,size,nullptr,GL_STREAM_DRAW);
+	void *p = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,0,size,GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
+	cg_assert(p,"Could not map the pixel unpack buffer");
+	std::memcpy(p,job.levels[level].data()+job.rowSize(level)*row,size);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindTexture(GL_TEXTURE_2D,job.texture_id);
+	if (job.format==GL_RGBA)
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	else
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, h, job.format, size, nullptr);
+}
+
+}
+
+void TextureLoader::request(GLuint texture_id, const std::string &fname, int width, int height, GLenum format) {
+	Loader &loader = getLoader();
+	auto job = std::make_shared<Job>();
+	job->texture_id = texture_id;
+	job->fname = fname;
+	job->width = width; job->height = height;
+	job->format = format;
+	loader.pending.push_back(job);
+	{
+		std::lock_guard<std::mutex> lock(loader.mutex);
+		loader.queue.push_back(job);
+		if (loader.workers.empty()) {
+			int nthreads = std::max(1,std::min(4,int(std::thread::hardware_concurrency())-1));
+			for(int i=0;i<nthreads;++i)
+				loader.workers.emplace_back(work,std::ref(loader));
+		}
+	}
+	loader.cv.notify_one();
+}
+
+void TextureLoader::cancel(GLuint texture_id) {
+	Loader &loader = getLoader();
+	auto it = std::find_if(loader.pending.begin(),loader.pending.end(),
+						   [&](const std::shared_ptr<Job> &job) { return job->texture_id==texture_id; });
+	if (it==loader.pending.end()) return;
+	std::lock_guard<std::mutex> lock(loader.mutex);
+	(*it)->cancelled = true;
+	loader.queue.erase(std::remove(loader.queue.begin(),loader.queue.end(),*it),loader.queue.end());
+	loader.pending.erase(it);
+}
+
+bool TextureLoader::isPending(GLuint texture_id) {
+	const Loader &loader = getLoader();
+	return std::any_of(loader.pending.begin(),loader.pending.end(),
+					   [&](const std::shared_ptr<Job> &job) { return job->texture_id==texture_id; });
+}
+
+bool TextureLoader::update(size_t budget) {
+	Loader &loader = getLoader();
+	// in a benchmark the result must not depend on how long the workers take,
+	// so every texture is completed in the same frame it was requested
+	if (Benchmark::isActive()) {
+		std::unique_lock<std::mutex> lock(loader.mutex);
+		loader.decoded_cv.wait(lock,[&]() {
+			return std::all_of(loader.pending.begin(),loader.pending.end(),
+							   [](const std::shared_ptr<Job> &job) { return job->decoded; });
+		});
+		budget = std::numeric_limits<size_t>::max();
+	}
+	size_t bytes = 0;
+	bool full = false;
+	for(size_t i=0;i<loader.pending.size() and not full;) {
+		Job &job = *loader.pending[i];
+		{
+			std::lock_guard<std::mutex> lock(loader.mutex);
+			if (not job.decoded) { ++i; continue; }
+		} // once decoded, the worker does not touch the job anymore
+		if (not job.error.empty()) {
+			std::string error = job.error;
+			loader.pending.erase(loader.pending.begin()+i);
+			cg_error(error);
+			continue;
+		}
+		if (job.next_level==-1) job.next_level = job.levels.size()-1;
+		while (job.next_level>=0) {
+			if (bytes>0 and bytes>=budget) { full = true; break; }
+			size_t row_size = job.rowSize(job.next_level);
+			int count = job.rowsCount(job.next_level);
+			int rows = std::min<size_t>(count-job.next_row,std::max<size_t>(1,(budget-bytes)/row_size));
+			upload(loader,job,job.next_level,job.next_row,rows);
+			bytes += rows*row_size;
+			job.next_row += rows;
+			if (job.next_row==count) { // complete, the texture can use it now
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.next_level);
+				std::vector<unsigned char>().swap(job.levels[job.next_level]);
+				--job.next_level;
+				job.next_row = 0;
+			}
+		}
+		if (job.next_level<0) loader.pending.erase(loader.pending.begin()+i);
+	}
+	if (bytes) glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0); // or glTexImage2D would read from it
+	return not loader.pending.empty();
+}
+
+int TextureLoader::levelsCount(int width, int height) {
+	int levels = 1;
+	for(int s=std::max(width,height); s>1; s>>=1)
+		++levels;
+	return levels;
+}
+
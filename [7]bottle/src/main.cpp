@@ -11,6 +11,11 @@
 #include "Window.hpp"
 #include "Callbacks.hpp"
 #include "Model.hpp"
+#include "AssetCache.hpp"
+#include "TextureLoader.hpp"
+#include "TextureAtlas.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20221019
 #include <iostream>
@@ -54,7 +59,11 @@ std::vector<glm::vec2> generateTextureCoordinatesForLid(const std::vector<glm::v
 	return vT;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" runs a headless benchmark instead, turning the model (see
+	// Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Texturas");
@@ -66,33 +75,42 @@ int main() {
 	glClearColor(0.6f,0.6f,0.8f,1.f);
 	Shader shader("shaders/texture");
 	
-	// load model and assign texture
+	// load model and assign texture (both images in a single atlas, which also
+	// updates the buffers with the new texture coordinates)
 	auto models = Model::load("bottle",Model::fKeepGeometry);
 	Model &bottle = models[0], &lid = models[1];
-	bottle.buffers.updateTexCoords(generateTextureCoordinatesForBottle(bottle.geometry.positions),true);
-	bottle.texture = Texture("models/label.png",true,false);
-	lid.buffers.updateTexCoords(generateTextureCoordinatesForLid(lid.geometry.positions),true);
-	lid.texture = Texture("models/lid.png",false,false);
+	bottle.geometry.tex_coords = generateTextureCoordinatesForBottle(bottle.geometry.positions);
+	lid.geometry.tex_coords = generateTextureCoordinatesForLid(lid.geometry.positions);
+	auto atlas = buildAtlas(models,{{"models/label.png",true,false},{"models/lid.png",false,false}});
 	
 	do {
 		
+		Profiler::newFrame();
+		if (Benchmark::isActive()) model_angle += static_cast<float>(Benchmark::getTimeStep());
+		
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 		
+		// upload some more of the textures that are still loading
+		TextureLoader::update();
+		
+		setFrameData(glm::vec4{2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
 		shader.use();
 		setMatrixes(shader);
-		shader.setLight(glm::vec4{2.f,-2.f,-4.f,0.f}, glm::vec3{1.f,1.f,1.f}, 0.15f);
-		for(Model &mod : models) {
-			mod.texture.bind();
-			shader.setMaterial(mod.material);
-			shader.setBuffers(mod.buffers);
-			glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
-			mod.buffers.draw();
+		atlas->bind(); // the same texture for every part
+		{
+			PROFILE_GPU_SCOPE("bottle");
+			for(Model &mod : models) {
+				shader.setMaterial(mod.material_index);
+				shader.setBuffers(mod.buffers);
+				glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+				mod.buffers.draw();
+			}
 		}
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
 }
 
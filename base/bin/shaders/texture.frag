@@ -7,22 +7,21 @@ in vec4 lightVSPosition;
 
 // propiedades del material
 uniform sampler2D colorTexture; // ambient and diffuse components
-uniform vec3 specularColor;
-uniform float shininess;
+#include "funcs/materials.glsl"
 
 // propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+#include "funcs/frameData.glsl"
 
 out vec4 fragColor;
 
 #include "funcs/calcPhong.frag"
 
 void main() {
+	MaterialData material = materials[materialIndex];
 	
 	vec4 tex = texture(colorTexture,fragTexCoords);
 	vec3 phong = calcPhong(lightVSPosition, lightColor,
-						   vec3(tex), vec3(tex), specularColor, shininess);
+						   vec3(tex), vec3(tex), material.specularColor, material.shininess);
 	fragColor = vec4(phong,tex.a);
 }
 
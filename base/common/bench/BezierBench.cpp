@@ -0,0 +1,132 @@
+// benchmark for the evaluation of Bezier curves of degree 3 to 7: the
+// recursive de Casteljau (Decast), Bezier::at (Bernstein, O(D)) and the batch
+// Bezier::evalMany, each one with and without derivatives, sampling the
+// curves at uniform values of t as BezierRenderer does; it also reports the
+// max distance of the results of at and evalMany to Decast
+//
+//   build: make bezier   (in this folder, see the Makefile)
+//   run: ./bezier [--samples N]   (it does not read any file)
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Debug.hpp"
+#include "Bezier.hpp"
+
+namespace {
+
+const int curves_count = 200;
+int samples_count = 500;
+
+// keeps the compiler from removing the evaluations
+volatile float sink;
+
+void consume(const std::vector<glm::vec3> &v) {
+	float s = 0.f;
+	for(const glm::vec3 &p : v) s += p.x+p.y+p.z;
+	sink = s;
+}
+
+// best of some runs of f (over all the curves), in ns per sample
+template<typename F>
+double bestTime(F f) {
+	using Clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for(int run=0;run<7;++run) {
+		auto t0 = Clock::now();
+		f();
+		best = std::min(best,std::chrono::duration<double,std::nano>(Clock::now()-t0).count());
+	}
+	return best/(double(curves_count)*samples_count);
+}
+
+float maxDistance(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b) {
+	float d = 0.f;
+	for(size_t i=0;i<a.size();++i) d = std::max(d,glm::length(a[i]-b[i]));
+	return d;
+}
+
+template<int D>
+void benchDegree(std::mt19937 &rng) {
+	std::uniform_real_distribution<float> coord(-1.f,1.f);
+	std::vector<Bezier<D>> curves(curves_count);
+	std::vector<std::array<glm::vec3,D>> diffs(curves_count); // for Decast's derivative
+	for(int c=0;c<curves_count;++c) {
+		for(int i=0;i<=D;++i) curves[c][i] = glm::vec3(coord(rng),coord(rng),coord(rng));
+		for(int i=0;i<D;++i) diffs[c][i] = curves[c][i+1]-curves[c][i];
+	}
+	std::vector<float> ts(samples_count);
+	for(int j=0;j<samples_count;++j) ts[j] = float(j)/(samples_count-1);
+	
+	size_t n = size_t(curves_count)*samples_count;
+	std::vector<glm::vec3> ref(n), ref_d(n), pts(n), pts_d(n);
+	
+	double t_decast = bestTime([&]() {
+		for(int c=0;c<curves_count;++c)
+			for(int j=0;j<samples_count;++j)
+				ref[c*samples_count+j] = Decast<D>(&curves[c][0],ts[j]);
+		consume(ref);
+	});
+	double t_decast_d = bestTime([&]() {
+		for(int c=0;c<curves_count;++c)
+			for(int j=0;j<samples_count;++j) {
+				ref[c*samples_count+j] = Decast<D>(&curves[c][0],ts[j]);
+				ref_d[c*samples_count+j] = Decast<D-1>(diffs[c].data(),ts[j])*float(D);
+			}
+		consume(ref); consume(ref_d);
+	});
+	
+	double t_at = bestTime([&]() {
+		for(int c=0;c<curves_count;++c)
+			for(int j=0;j<samples_count;++j)
+				pts[c*samples_count+j] = curves[c].at(ts[j]);
+		consume(pts);
+	});
+	float e_at = maxDistance(pts,ref);
+	double t_at_d = bestTime([&]() {
+		for(int c=0;c<curves_count;++c)
+			for(int j=0;j<samples_count;++j)
+				pts[c*samples_count+j] = curves[c].at(ts[j],pts_d[c*samples_count+j]);
+		consume(pts); consume(pts_d);
+	});
+	float e_at_d = maxDistance(pts_d,ref_d);
+	
+	double t_many = bestTime([&]() {
+		for(int c=0;c<curves_count;++c)
+			curves[c].evalMany(ts.data(),samples_count,&pts[c*samples_count]);
+		consume(pts);
+	});
+	float e_many = maxDistance(pts,ref);
+	double t_many_d = bestTime([&]() {
+		for(int c=0;c<curves_count;++c)
+			curves[c].evalMany(ts.data(),samples_count,&pts[c*samples_count],&pts_d[c*samples_count]);
+		consume(pts); consume(pts_d);
+	});
+	float e_many_d = maxDistance(pts_d,ref_d);
+	
+	std::printf("%2d  %7.1f %7.1f | %7.1f %7.1f | %7.1f %7.1f   | %8.1e %8.1e %8.1e %8.1e\n",
+				D,t_decast,t_decast_d,t_at,t_at_d,t_many,t_many_d,e_at,e_at_d,e_many,e_many_d);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	for(int i=1;i<argc;++i) {
+		if (std::strcmp(argv[i],"--samples")==0 and i+1<argc) samples_count = std::max(2,std::atoi(argv[++i]));
+		else { std::fprintf(stderr,"usage: %s [--samples N]\n",argv[0]); return 1; }
+	}
+	std::printf("ns per sample (%d curves x %d samples, best of 7), and max error against Decast\n",
+				curves_count,samples_count);
+	std::printf(" D   Decast  +deriv |      at  +deriv | evalMany +derivs | err(at)  +deriv  err(many) +derivs\n");
+	std::mt19937 rng(42);
+	benchDegree<3>(rng);
+	benchDegree<4>(rng);
+	benchDegree<5>(rng);
+	benchDegree<6>(rng);
+	benchDegree<7>(rng);
+	return 0;
+}
@@ -0,0 +1,77 @@
+// the post-transform vertex cache efficiency (ACMR/ATVR, FIFO of 16) of every
+// part before and after optimizeGeometry (GeometryOptimizer, what fOptimize
+// does in Model::load), and the time it takes; it also checks that the set of
+// triangles is the same (only the order may change)
+//
+//   build: make -C ../common/bench optimize   (see the Makefile there)
+//   run (from bin): ../common/bench/optimize models/suzanne.obj ...
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ObjMesh.hpp"
+#include "GeometryOptimizer.hpp"
+
+namespace {
+
+// the positions of each triangle, starting by the smallest one (the
+// optimization may not keep the first vertex), sorted
+std::vector<std::array<float,9>> triangleSet(const Geometry &g) {
+	std::vector<std::array<float,9>> v;
+	for(size_t i=0;i+2<g.triangles.size();i+=3) {
+		std::array<float,9> t;
+		for(int j=0;j<3;++j)
+			for(int k=0;k<3;++k)
+				t[j*3+k] = g.positions[g.triangles[i+j]][k];
+		std::array<float,9> r = t;
+		for(int s=1;s<3;++s) {
+			std::array<float,9> aux;
+			for(int j=0;j<9;++j) aux[j] = t[(j+s*3)%9];
+			r = std::min(r,aux);
+		}
+		v.push_back(r);
+	}
+	std::sort(v.begin(),v.end());
+	return v;
+}
+
+// best of some runs, in milliseconds (each one over a copy of g)
+double bestTime(const Geometry &g, Geometry &result) {
+	using Clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for(int run=0;run<5;++run) {
+		result = g;
+		auto t0 = Clock::now();
+		optimizeGeometry(result);
+		best = std::min(best,std::chrono::duration<double,std::milli>(Clock::now()-t0).count());
+	}
+	return best;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> files(argv+1,argv+argc);
+	if (files.empty()) files = { "models/suzanne.obj", "models/chookity.obj", "models/teapot.obj" };
+
+	std::printf("%-40s %8s %16s %16s %9s\n","part","tris","ACMR","ATVR","time");
+	bool all_equal = true;
+	for(const std::string &fname : files) {
+		ObjMesh obj = readObj(fname);
+		for(const ObjMesh::Part &part : obj.parts) {
+			Geometry g = toGeometry(obj,part), opt;
+			if (g.triangles.empty()) continue;
+			double ms = bestTime(g,opt);
+			VertexCacheStats before = analyzeVertexCache(g), after = analyzeVertexCache(opt);
+			all_equal = all_equal and triangleSet(g)==triangleSet(opt);
+			std::string name = fname.substr(fname.find_last_of("/\\")+1);
+			if (not part.name.empty()) name += " "+part.name;
+			std::printf("%-40s %8zu %6.3f -> %6.3f %6.3f -> %6.3f %6.2f ms\n",name.c_str(),
+						g.triangles.size()/3,before.acmr,after.acmr,before.atvr,after.atvr,ms);
+		}
+	}
+	if (not all_equal) std::printf("ERROR: the triangles differ\n");
+	return all_equal ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// benchmark for the vertex dedup of toGeometry (VertexTable, in ObjMesh.cpp)
+// against the previous std::unordered_map version (copied here as the
+// reference), checking also that both give the same Geometry
+//
+//   build: make -C ../common/bench vertex_table   (see the Makefile there)
+//   run (from bin): ../common/bench/vertex_table [--repeat K] models/suzanne.obj ...
+//
+// --repeat K converts each model replicated K times (with its own copy of the
+// vertexes), to measure bigger meshes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "ObjMesh.hpp"
+
+namespace std {
+
+	// the hash as it was (it mixes get<0> twice and ignores get<2>)
+	template <> struct hash<std::tuple<int,int,int>> {
+		std::size_t operator()(const std::tuple<int,int,int>& p) const {
+			return ( ( hash<int>()(std::get<0>(p))
+					   ^ (hash<int>()(std::get<1>(p)) << 1) ) >> 1)
+				   ^ (hash<int>()(std::get<0>(p)) << 1);
+		}
+	};
+
+}
+
+namespace {
+
+// toGeometry as it was before VertexTable
+Geometry referenceToGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
+	Geometry g;
+	std::unordered_map<std::tuple<int,int,int>,int> map;
+	auto addVertex = [&](const ObjMesh::Element &e, int inode) {
+		auto t = std::make_tuple(e.pos[inode],e.norms[inode],e.tcs[inode]);
+		auto p = map.insert({t,g.positions.size()});
+		if (p.second) {
+			g.positions.push_back(obj.positions[e.pos[inode]]);
+			if (e.norms[inode]!=-1) g.normals.push_back(obj.normals[e.norms[inode]]);
+			if (e.tcs[inode]!=-1) g.tex_coords.push_back(obj.tex_coords[e.tcs[inode]]);
+		}
+		g.triangles.push_back(p.first->second);
+	};
+	for(const ObjMesh::Element &e : part.elements) {
+		addVertex(e,0); addVertex(e,1); addVertex(e,2);
+		if (e.pos[3]==-1) continue;
+		addVertex(e,0); addVertex(e,2); addVertex(e,3);
+	}
+	return g;
+}
+
+// the same mesh k times, each copy with its own vertexes (in a single part)
+ObjMesh replicate(const ObjMesh &obj, int k) {
+	ObjMesh r;
+	r.parts.resize(1);
+	for(int i=0;i<k;++i) {
+		int np = r.positions.size(), nn = r.normals.size(), nt = r.tex_coords.size();
+		r.positions.insert(r.positions.end(),obj.positions.begin(),obj.positions.end());
+		r.normals.insert(r.normals.end(),obj.normals.begin(),obj.normals.end());
+		r.tex_coords.insert(r.tex_coords.end(),obj.tex_coords.begin(),obj.tex_coords.end());
+		for(const ObjMesh::Part &part : obj.parts) {
+			for(ObjMesh::Element e : part.elements) {
+				for(int j=0;j<4;++j) {
+					if (e.pos[j]!=-1) e.pos[j] += np;
+					if (e.norms[j]!=-1) e.norms[j] += nn;
+					if (e.tcs[j]!=-1) e.tcs[j] += nt;
+				}
+				r.parts[0].elements.push_back(e);
+			}
+		}
+	}
+	return r;
+}
+
+bool sameGeometry(const Geometry &a, const Geometry &b) {
+	return a.positions==b.positions and a.normals==b.normals and
+		   a.tex_coords==b.tex_coords and a.triangles==b.triangles;
+}
+
+// best of some runs of f over all the parts, in milliseconds
+template<typename F>
+double bestTime(const ObjMesh &obj, F f, size_t &vertexes) {
+	using Clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for(int run=0;run<7;++run) {
+		vertexes = 0;
+		auto t0 = Clock::now();
+		for(const ObjMesh::Part &part : obj.parts)
+			vertexes += f(obj,part).positions.size();
+		best = std::min(best,std::chrono::duration<double,std::milli>(Clock::now()-t0).count());
+	}
+	return best;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	int repeat = 1;
+	std::vector<std::string> files;
+	for(int i=1;i<argc;++i) {
+		if (std::strcmp(argv[i],"--repeat")==0 and i+1<argc) repeat = std::max(1,std::atoi(argv[++i]));
+		else files.push_back(argv[i]);
+	}
+	if (files.empty()) files = { "models/suzanne.obj", "models/chookity.obj", "models/teapot.obj" };
+
+	std::printf("%-24s %8s %10s %10s %8s\n","model","verts","before","after","speedup");
+	bool all_equal = true;
+	for(const std::string &fname : files) {
+		ObjMesh obj = readObj(fname);
+		if (repeat>1) obj = replicate(obj,repeat);
+		for(const ObjMesh::Part &part : obj.parts)
+			all_equal = all_equal and sameGeometry(referenceToGeometry(obj,part),toGeometry(obj,part));
+		size_t verts;
+		double before = bestTime(obj,referenceToGeometry,verts);
+		Geometry (*current)(const ObjMesh&, const ObjMesh::Part&) = toGeometry;
+		double after = bestTime(obj,current,verts);
+		std::string name = fname.substr(fname.find_last_of("/\\")+1);
+		if (repeat>1) name += " x"+std::to_string(repeat);
+		std::printf("%-24s %8zu %7.2f ms %7.2f ms %7.1fx\n",name.c_str(),verts,before,after,before/after);
+	}
+	if (not all_equal) std::printf("ERROR: the geometries differ\n");
+	return all_equal ? 0 : 1;
+}
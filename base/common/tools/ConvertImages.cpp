@@ -0,0 +1,22 @@
+// converts images to the block compressed format that Texture loads directly
+// (a ".ctex" file next to each one, see CompressedImage), so they do not need
+// to be converted in background the first time a demo loads them
+//
+//   build: make -C ../common/tools convert_images   (see the Makefile there)
+//   run (from bin): ../common/tools/convert_images models/*.png
+#include <cstdio>
+#include "CompressedImage.hpp"
+
+int main(int argc, char *argv[]) {
+	if (argc<2) {
+		std::fprintf(stderr,"usage: %s image...\n",argv[0]);
+		return 1;
+	}
+	int failed = 0;
+	for(int i=1;i<argc;++i) {
+		bool ok = convertImage(argv[i]);
+		std::printf("%s: %s\n",argv[i],ok?"ok":"FAILED");
+		if (not ok) ++failed;
+	}
+	return failed==0 ? 0 : 1;
+}
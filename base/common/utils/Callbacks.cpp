@@ -81,3 +81,14 @@ void setMatrixes(Shader &shader) {
 	shader.setMatrixes(ms[0],ms[1],ms[2]);
 }
 
+void setFrameData(const glm::vec4 &light_position, const glm::vec3 &light_color, float ambient_strength) {
+	auto ms = common_callbacks::getMatrixes();
+	FrameData data;
+	data.view_matrix = ms[1];
+	data.projection_matrix = ms[2];
+	data.light_position = light_position;
+	data.light_color = light_color;
+	data.ambient_strength = ambient_strength;
+	data.upload();
+}
+
@@ -4,34 +4,193 @@
 #include "Model.hpp"
 #include "Debug.hpp"
 #include "ObjMesh.hpp"
+#include "MeshCache.hpp"
+#include "GeometryOptimizer.hpp"
+#include "Simplifier.hpp"
+#include "AssetCache.hpp"
+#include "Shaders.hpp"
 #include "Misc.hpp"
+#include "Profiler.hpp"
 
-Model Model::loadSingle(const std::string &name, int flags) {
-	ObjMesh obj = readObj("models/"+name+".obj");
-	if (!(flags&fDontFit)) centerAndResize(obj.positions);
-	Geometry geometry = toGeometry(obj,0);
-	if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-	return Model(std::move(geometry), obj.parts[0].material, flags&fKeepGeometry);
+size_t Model::stream_budget = 64*1024*1024;
+int Model::lod_count = 4;
+
+// reorders triangles and vertexes for the GPU caches (see GeometryOptimizer),
+// saving the post-transform cache efficiency before and after in part
+static void optimize(Model::PreparedPart &part) {
+	part.cache_before = analyzeVertexCache(part.geometry);
+	optimizeGeometry(part.geometry);
+	part.cache_after = analyzeVertexCache(part.geometry);
+	cg_info("Optimized "+part.name+": ACMR "+std::to_string(part.cache_before.acmr)+" -> "+std::to_string(part.cache_after.acmr)
+			+", ATVR "+std::to_string(part.cache_before.atvr)+" -> "+std::to_string(part.cache_after.atvr));
 }
 
-std::vector<Model> Model::load(const std::string &name, int flags) {
-	auto obj = readObj("models/"+name+".obj");
-	if (!(flags&fDontFit)) centerAndResize(obj.positions);
+// simplified versions of the geometry for fLods, each one with half the
+// triangles of the previous one; it stops early if the simplification gets
+// stuck (too many seams or borders)
+static void generateLods(Model::PreparedPart &part) {
+	const Geometry &geometry = part.geometry;
+	glm::vec3 pmin, pmax;
+	std::tie(pmin,pmax) = getBoundingBox(geometry.positions);
+	part.lod_center = (pmin+pmax)*.5f;
+	part.lod_radius = glm::length(pmax-pmin)*.5f;
+	size_t ntris = geometry.triangles.size()/3, prev = ntris;
+	std::string info = std::to_string(ntris);
+	for(int i=1;i<=Model::lod_count;++i) {
+		float error;
+		Geometry lod = simplifyGeometry(geometry,ntris>>i,&error);
+		if (lod.triangles.size()/3>prev*9/10) break;
+		prev = lod.triangles.size()/3;
+		if (part.flags&Model::fOptimize) optimizeGeometry(lod);
+		part.lods.push_back(std::move(lod));
+		part.lod_errors.push_back(error);
+		info += " -> "+std::to_string(prev);
+	}
+	cg_info("LODs for "+part.name+": "+info+" triangles");
+}
+
+// reads the .obj with ObjStream and uploads it by windows, so the complete
+// ObjMesh/Geometry are never in memory (and the mesh cache is not used);
+// fInterleaved, fQuantized and fLods are ignored here, appended buffers are 
+// always separated and in floats; with only_part>=0 just that part is
+// uploaded and returned (if it is not empty)
+static std::vector<Model> loadStreamed(const std::string &path, int flags, int only_part=-1) {
+	cg_assert(!(flags&Model::fKeepGeometry),"fKeepGeometry can not be used with fStream");
+	ObjStream obj(path);
+	if (!(flags&Model::fDontFit)) centerAndResize(obj.positions);
+	if (flags&Model::fRegenerateNormals or obj.normals.empty()) obj.generateNormals();
+	
+	std::vector<GeometryRenderer> buffers(obj.parts.size());
+	obj.readFaces(Model::stream_budget,[&](int ipart, const Geometry &window) {
+		if (only_part>=0 and ipart!=only_part) return;
+		if (flags&Model::fOptimize) {
+			Geometry aux = window;
+			optimizeGeometry(aux);
+			buffers[ipart].append(aux,flags&Model::fDynamic);
+		} else
+			buffers[ipart].append(window,flags&Model::fDynamic);
+	});
 	
 	std::vector<Model> vret; vret.reserve(obj.parts.size());
-	for (auto &part : obj.parts) {
-		Geometry geometry = toGeometry(obj,part);
-		if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-		vret.emplace_back(std::move(geometry), part.material, flags&fKeepGeometry);
+	for(size_t i=0;i<obj.parts.size();++i) {
+		if (obj.parts[i].faces==0 or (only_part>=0 and static_cast<int>(i)!=only_part)) continue;
+		vret.emplace_back(std::move(buffers[i]), obj.parts[i].material);
+	}
+	return vret;
+}
+
+static std::shared_ptr<const Texture> loadTexture(const Material &m) {
+	if (m.texture.empty()) return nullptr;
+	return AssetCache::texture(m.texture);
+}
+
+Model::Model(const Geometry &g, const Material &m) 
+	: buffers(g), material(m), 
+	  material_index(MaterialTable::getIndex(m)), texture(loadTexture(m))
+{
+	
+}
+
+Model::Model(Geometry &&g, const Material &m, bool keep_geometry, 
+			 bool dynamic, bool interleaved, bool quantized) 
+	: buffers(g,dynamic,interleaved,quantized), material(m), 
+	  material_index(MaterialTable::getIndex(m)), texture(loadTexture(m))
+{
+	if (keep_geometry) geometry = std::move(g);
+}
+
+Model::Model(GeometryRenderer &&b, const Material &m) 
+	: buffers(std::move(b)), material(m), 
+	  material_index(MaterialTable::getIndex(m)), texture(loadTexture(m))
+{
+	
+}
+
+Model::Model(PreparedPart &&part) 
+	: Model(std::move(part.geometry), part.material, part.flags&fKeepGeometry, 
+			part.flags&fDynamic, part.flags&fInterleaved, part.flags&fQuantized)
+{
+	lod_center = part.lod_center;
+	lod_radius = part.lod_radius;
+	cache_before = part.cache_before;
+	cache_after = part.cache_after;
+	for(size_t i=0;i<part.lods.size();++i) {
+		lods.push_back({GeometryRenderer(part.lods[i],part.flags&fDynamic,part.flags&fInterleaved,
+										 part.flags&fQuantized), part.lod_errors[i]});
+	}
+}
+
+static Model::PreparedPart preparePart(MeshCache &cache, MeshCache::Part &part, int flags) {
+	Geometry &geometry = part.geometry;
+	if (!(flags&Model::fDontFit)) centerAndResize(geometry.positions,cache.pmin,cache.pmax);
+	if (flags&Model::fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
+	Model::PreparedPart prepared;
+	prepared.name = part.name;
+	prepared.geometry = std::move(geometry);
+	prepared.material = part.material;
+	prepared.flags = flags;
+	if (flags&Model::fOptimize) optimize(prepared);
+	if (flags&Model::fLods) generateLods(prepared);
+	return prepared;
+}
+
+void Model::prepare(const std::string &name, int flags, const std::function<void(PreparedPart&&)> &callback) {
+	cg_assert(!(flags&fStream),"fStream models can not be prepared");
+	MeshCache cache = loadMeshCache("models/"+name+".obj");
+	for (auto &part : cache.parts)
+		callback(preparePart(cache,part,flags));
+}
+
+Model Model::loadSingle(const std::string &name, int flags) {
+	if (flags&fStream) {
+		// the first part of the file, as below (load skips the empty ones)
+		std::vector<Model> vret = loadStreamed("models/"+name+".obj",flags,0);
+		cg_assert(not vret.empty(),"The first part of the model is empty: "+name);
+		return std::move(vret[0]);
 	}
+	MeshCache cache = loadMeshCache("models/"+name+".obj");
+	cg_assert(not cache.parts[0].geometry.triangles.empty(),"The first part of the model is empty: "+name);
+	return Model(preparePart(cache,cache.parts[0],flags));
+}
+
+std::vector<Model> Model::load(const std::string &name, int flags) {
+	PROFILE_SCOPE("Model::load");
+	if (flags&fStream) return loadStreamed("models/"+name+".obj",flags);
+	std::vector<Model> vret;
+	prepare(name,flags,[&](PreparedPart &&part) {
+		vret.emplace_back(std::move(part));
+	});
 	return vret;
 }
 
+const GeometryRenderer &Model::selectLod(const glm::mat4 &model_view, const glm::mat4 &projection, 
+										int viewport_height, float max_pixels) const 
+{
+	if (lods.empty()) return buffers;
+	// pixels per model unit (assuming an uniform scale in model_view)
+	float scale = glm::length(glm::vec3(model_view[0]));
+	float pixels = projection[1][1]*viewport_height*.5f*scale;
+	if (projection[2][3]!=0.f) { // perspective
+		float dist = -(model_view*glm::vec4(lod_center,1.f)).z - lod_radius*scale;
+		if (dist<=0.f) return buffers; // the camera is inside the sphere
+		pixels /= dist;
+	}
+	const GeometryRenderer *best = &buffers;
+	for(const Lod &lod : lods) {
+		if (lod.error*pixels>max_pixels) break;
+		best = &lod.buffers;
+	}
+	return *best;
+}
+
 void centerAndResize(std::vector<glm::vec3> &v) {
 	// get global bb
 	glm::vec3 pmin, pmax;
 	std::tie(pmin,pmax) = getBoundingBox(v);
-	
+	centerAndResize(v,pmin,pmax);
+}
+
+void centerAndResize(std::vector<glm::vec3> &v, glm::vec3 pmin, glm::vec3 pmax) {
 	// center on 0,0,0
 	glm::vec3 center = (pmax+pmin)/2.f;
 	for(glm::vec3 &p : v) 
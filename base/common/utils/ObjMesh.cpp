@@ -1,11 +1,17 @@
 #include <fstream>
 #include <map>
 #include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
 #include <glm/glm.hpp>
 #include "ObjMesh.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
-#include <unordered_map>
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+#include <cstdint>
+#include <functional>
 
 namespace {
 
@@ -78,77 +84,243 @@ std::map<std::string,Material> loadMaterialsLib(const std::string &path, const s
 	return lib;
 }
 
+// --- parallel parsing of the .obj file ---
+
+// result of parsing a range of lines of the file; the commands that change
+// the current part (o, usemtl, mtllib) are stored in order along with the
+// number of faces read before them, so the chunks can be merged afterwards
+// exactly as if the whole file had been read sequentially
+struct ObjChunk {
+	struct Command {
+		enum Type { NewObject, UseMaterial, MaterialLib, EnsurePart } type;
+		size_t face_count;
+		std::string arg;
+	};
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> tex_coords;
+	std::vector<ObjMesh::Element> elements;
+	std::vector<Command> commands;
+	bool has_part = false;
+};
+
+const char *skipSpaces(const char *p, const char *end) {
+	while (p!=end and (*p==' ' or *p=='\t' or *p=='\r')) ++p;
+	return p;
+}
+
+bool lineStartsWith(const char *p, const char *end, const char *con) {
+	for(;*con;++p,++con)
+		if (p==end or *p!=*con) return false;
+	return true;
+}
+
+std::string readArg(const char *p, const char *end) {
+	while (end!=p and (end[-1]=='\r' or end[-1]==' ')) --end;
+	return std::string(p,end);
+}
+
+// lines are parsed in place (no std::string per line), numbers are read with
+// strtof/strtol which stop at the '\n' that ends every line in the chunk
+glm::vec3 readVec3(const char *p) {
+	char *q; glm::vec3 v;
+	v.x = std::strtof(p,&q);
+	v.y = std::strtof(q,&q);
+	v.z = std::strtof(q,&q);
+	return v;
+}
+
+glm::vec2 readVec2(const char *p) {
+	char *q; glm::vec2 v;
+	v.x = std::strtof(p,&q);
+	v.y = std::strtof(q,&q);
+	return v;
+}
+
+ObjMesh::Element readFace(const char *p, const char *end) {
+	ObjMesh::Element e; 
+	int in = 0; char *q;
+	for(p=skipSpaces(p,end); p!=end; p=skipSpaces(p,end)) {
+		cg_assert(in<4,"Face with more than 4 vertexes are not supported yet");
+		e.pos[in] = std::strtol(p,&q,10)-1;
+		e.tcs[in] = e.norms[in] = -1;
+		if (q==p) break;
+		p = q;
+		if (p!=end and *p=='/') {
+			if (++p!=end and *p!='/') {
+				e.tcs[in] = std::strtol(p,&q,10)-1; p = q;
+			}
+			if (p!=end and *p=='/') {
+				e.norms[in] = std::strtol(p+1,&q,10)-1; p = q;
+			}
+		}
+		++in;
+	}
+	cg_assert(in>2,"Face with less than 3 vertexes");
+	if (in==3) e.pos[3] = e.norms[3] = e.tcs[3] = -1;
+	return e;
+}
+
+void parseLine(const char *p, const char *end, ObjChunk &chunk) {
+	if (p==end or *p=='#' or *p=='\r') return;
+	if (lineStartsWith(p,end,"o ")) {
+		chunk.commands.push_back({ObjChunk::Command::NewObject,chunk.elements.size(),readArg(p+2,end)});
+		chunk.has_part = true;
+	} else if (lineStartsWith(p,end,"mtllib ")) {
+		chunk.commands.push_back({ObjChunk::Command::MaterialLib,chunk.elements.size(),readArg(p+7,end)});
+	} else {
+		if (not chunk.has_part) {
+			chunk.commands.push_back({ObjChunk::Command::EnsurePart,chunk.elements.size(),""});
+			chunk.has_part = true;
+		}
+		if (lineStartsWith(p,end,"v ")) {
+			chunk.positions.push_back(readVec3(p+2));
+		} else if (lineStartsWith(p,end,"vn ")) {
+			chunk.normals.push_back(readVec3(p+3));
+		} else if (lineStartsWith(p,end,"vt ")) {
+			chunk.tex_coords.push_back(readVec2(p+3));
+		} else if (lineStartsWith(p,end,"f ")) {
+			chunk.elements.push_back(readFace(p+2,end));
+		} else if (lineStartsWith(p,end,"usemtl ")) {
+			chunk.commands.push_back({ObjChunk::Command::UseMaterial,chunk.elements.size(),readArg(p+7,end)});
+		}
+	}
+}
+
+// parses complete lines (each one ending with '\n') in [begin,end)
+void parseChunk(const char *begin, const char *end, ObjChunk &chunk) {
+	PROFILE_FUNCTION();
+	while (begin!=end) {
+		const char *eol = static_cast<const char*>(std::memchr(begin,'\n',end-begin));
+		parseLine(begin,eol,chunk);
+		begin = eol+1;
+	}
+}
+
+// smaller files are not worth the threads
+const size_t min_chunk_size = 256*1024;
+
+std::vector<ObjChunk> parseObj(const MappedFile &file) {
+	const char *begin = file.begin(), *end = file.end();
+	
+	// the last line may not end with '\n', and strtof could read past the end
+	// of the mapping, so that line is copied and parsed apart
+	std::string last_line;
+	while (end!=begin and end[-1]!='\n') --end;
+	last_line.assign(end,file.end());
+	last_line += '\n';
+	
+	size_t nthreads = std::max(1u,std::thread::hardware_concurrency());
+	size_t nchunks = std::max<size_t>(1,std::min(nthreads,(end-begin)/min_chunk_size));
+	std::vector<ObjChunk> chunks(nchunks);
+	
+	// chunk boundaries are moved forward to the next line start
+	std::vector<const char*> limits(nchunks+1,end);
+	limits[0] = begin;
+	for(size_t i=1;i<nchunks;++i) {
+		const char *p = std::max(limits[i-1],begin+(end-begin)*i/nchunks);
+		while (p!=end and p[-1]!='\n') ++p;
+		limits[i] = p;
+	}
+	
+	std::vector<std::thread> workers;
+	for(size_t i=1;i<nchunks;++i)
+		workers.emplace_back(parseChunk,limits[i],limits[i+1],std::ref(chunks[i]));
+	parseChunk(limits[0],limits[1],chunks[0]);
+	for(std::thread &t : workers) t.join();
+	
+	parseChunk(last_line.data(),last_line.data()+last_line.size(),chunks.back());
+	return chunks;
+}
+
+// calls f(begin,eol,offset) for every line of the file, with the same
+// handling of the last line as parseObj (so begin may not point to the file,
+// offset is always the position of the line in the file)
+template<typename F>
+void forEachLine(const MappedFile &file, F f) {
+	const char *begin = file.begin(), *end = file.end();
+	while (end!=begin and end[-1]!='\n') --end;
+	for(const char *eol; begin!=end; begin=eol+1) {
+		eol = static_cast<const char*>(std::memchr(begin,'\n',end-begin));
+		f(begin,eol,static_cast<size_t>(begin-file.begin()));
+	}
+	std::string last_line(end,file.end());
+	if (not last_line.empty()) 
+		f(last_line.data(),last_line.data()+last_line.size(),static_cast<size_t>(end-file.begin()));
+}
+
 }
 
 ObjMesh readObj(const std::string &full_path) {
+	PROFILE_FUNCTION();
 	cg_info( "Reading obj file: " + full_path + "..." );
 	std::string path = extractFolder(full_path);
-	std::ifstream file(full_path);
-	cg_assert(file.is_open(),"Could not open obj file");
+	MappedFile file(full_path);
+	cg_assert(file.isOk(),"Could not open obj file");
+	
+	std::vector<ObjChunk> chunks = parseObj(file);
 	
 	ObjMesh meshes;
+	size_t npos = 0, nnorm = 0, ntcs = 0;
+	for(const ObjChunk &chunk : chunks) {
+		npos += chunk.positions.size();
+		nnorm += chunk.normals.size();
+		ntcs += chunk.tex_coords.size();
+	}
+	meshes.positions.reserve(npos);
+	meshes.normals.reserve(nnorm);
+	meshes.tex_coords.reserve(ntcs);
+	
+	// replay the commands of every chunk in file order
 	ObjMesh::Part *current_part = nullptr;
 	std::map<std::string,Material> materials_lib;
 	std::string current_name;
-	
-	for(std::string line; std::getline(file,line); ) {
-		if (line.empty() or line[0]=='#') continue;
-		if (startsWith(line,"o ")) {
-			meshes.parts.push_back({}); 
-			current_part = &meshes.parts.back();
-			current_name = current_part->name = line.substr(2);
-		} else if (startsWith(line,"mtllib ")) {
-			materials_lib = loadMaterialsLib(path,line.substr(7));
-		} else {
-			if (not current_part) {
-				meshes.parts.push_back({});
+	for(const ObjChunk &chunk : chunks) {
+		meshes.positions.insert(meshes.positions.end(),chunk.positions.begin(),chunk.positions.end());
+		meshes.normals.insert(meshes.normals.end(),chunk.normals.begin(),chunk.normals.end());
+		meshes.tex_coords.insert(meshes.tex_coords.end(),chunk.tex_coords.begin(),chunk.tex_coords.end());
+		
+		size_t nfaces = 0;
+		auto addFaces = [&](size_t upto) {
+			if (upto==nfaces) return;
+			current_part->elements.insert(current_part->elements.end(),
+										  chunk.elements.begin()+nfaces,
+										  chunk.elements.begin()+upto);
+			nfaces = upto;
+		};
+		
+		for(const ObjChunk::Command &cmd : chunk.commands) {
+			addFaces(cmd.face_count);
+			switch (cmd.type) {
+			case ObjChunk::Command::NewObject:
+				meshes.parts.push_back({}); 
 				current_part = &meshes.parts.back();
-			}
-			if (startsWith(line,"v ")) {
-				meshes.positions.push_back(readVec3(line,2));
-			} else if (startsWith(line,"vn ")) {
-				meshes.normals.push_back(readVec3(line,3));
-			} else if (startsWith(line,"vt ")) {
-				meshes.tex_coords.push_back(readVec2(line,3));
-			} else if (startsWith(line,"f ")) {
-				ObjMesh::Element e; 
-				int is = 2, in = 0, l = line.size();
-				while(is<l) {
-					cg_assert(in<4,"Face with more than 4 vertexes are not supported yet");
-					e.pos[in] = readInt(line,is)-1;
-					if (line[is]=='/') {
-						if (line[++is]=='/') {
-							e.tcs[in] = -1;
-							e.norms[in] = readInt(line,++is)-1;
-						} else {
-							e.tcs[in] = readInt(line,is)-1;
-							if (line[is]=='/') {
-								e.norms[in] = readInt(line,++is)-1;
-							} else {
-								e.norms[in] = -1;
-							}
-						}
-					} else {
-						e.tcs[in] = -1;
-						e.norms[in] = -1;
-					}
-					++in;
+				current_name = current_part->name = cmd.arg;
+				break;
+			case ObjChunk::Command::MaterialLib:
+				materials_lib = loadMaterialsLib(path,cmd.arg);
+				meshes.material_libs.push_back(path+cmd.arg);
+				break;
+			case ObjChunk::Command::EnsurePart:
+				if (not current_part) {
+					meshes.parts.push_back({});
+					current_part = &meshes.parts.back();
 				}
-				cg_assert(in>2,"Face with less than 3 vertexes");
-				if (in==3) e.pos[3] = e.norms[3] = e.tcs[3] = -1;
-				current_part->elements.push_back(e);
-			} else if (startsWith(line,"usemtl ")) {
+				break;
+			case ObjChunk::Command::UseMaterial:
 				if (not current_part->elements.empty()) {
 					meshes.parts.push_back({}); 
 					current_part = &meshes.parts.back();
 				}
-				current_part->name = current_name+":"+line.substr(7);
-				if  (line.substr(7)!="None") {
-					cg_assert(materials_lib.count(line.substr(7)),"Material not found");
-					current_part->material = materials_lib[line.substr(7)];
+				current_part->name = current_name+":"+cmd.arg;
+				if  (cmd.arg!="None") {
+					cg_assert(materials_lib.count(cmd.arg),"Material not found: "+cmd.arg);
+					current_part->material = materials_lib[cmd.arg];
 				}
+				break;
 			}
 		}
+		addFaces(chunk.elements.size());
 	}
 	cg_assert(not meshes.parts.empty(),"No mesh object found in file");
 	
@@ -170,37 +342,116 @@ ObjMesh readObj(const std::string &full_path) {
 //	return g;
 //}
 
-namespace std {
+namespace {
+
+// hash table with open addressing (linear probing) from the (position, normal,
+// texture coordinates) indexes of an obj vertex to its index in the Geometry;
+// entries are stored inline in a single array (no allocation per vertex)
+class VertexTable {
+public:
+	struct Entry { int pos, norm, tc, index; };
+	
+	// makes room for n vertexes without rehashing
+	void reserve(size_t n) {
+		size_t capacity = 16;
+		while (capacity<2*n) capacity *= 2;
+		if (capacity>entries.size()) rehash(capacity);
+	}
 	
-	template <> struct hash<std::tuple<int,int,int>> {
-		std::size_t operator()(const std::tuple<int,int,int>& p) const {
-			return ( ( hash<int>()(std::get<0>(p))
-		               ^ (hash<int>()(std::get<1>(p)) << 1) ) >> 1)
-				   ^ (hash<int>()(std::get<0>(p)) << 1);
+	// returns the index stored for the key, or inserts new_index if the key
+	// is not there (second is true in that case)
+	std::pair<int,bool> insert(int pos, int norm, int tc, int new_index) {
+		if (2*(count+1)>entries.size()) rehash(std::max<size_t>(16,2*entries.size()));
+		size_t mask = entries.size()-1;
+		for(size_t i = hash(pos,norm,tc)&mask; ; i = (i+1)&mask) {
+			Entry &e = entries[i];
+			if (e.index==-1) {
+				e = {pos,norm,tc,new_index}; ++count;
+				return {new_index,true};
+			}
+			if (e.pos==pos and e.norm==norm and e.tc==tc) 
+				return {e.index,false};
 		}
-	};
+	}
 	
-}
+	// removes all the entries, but keeps the memory
+	void clear() {
+		std::fill(entries.begin(),entries.end(),Entry{0,0,0,-1});
+		count = 0;
+	}
+	
+private:
+	static size_t hash(int pos, int norm, int tc) {
+		// mix the three indexes, then murmur3's finalizer to spread the bits
+		uint32_t h = static_cast<uint32_t>(pos)*0x9E3779B1u 
+			^ static_cast<uint32_t>(norm)*0x85EBCA77u 
+			^ static_cast<uint32_t>(tc)*0xC2B2AE3Du;
+		h ^= h>>16; h *= 0x85EBCA6Bu;
+		h ^= h>>13; h *= 0xC2B2AE35u;
+		h ^= h>>16;
+		return h;
+	}
+	
+	void rehash(size_t capacity) {
+		std::vector<Entry> old(capacity,Entry{0,0,0,-1});
+		old.swap(entries);
+		size_t mask = capacity-1;
+		for(const Entry &e : old) {
+			if (e.index==-1) continue;
+			size_t i = hash(e.pos,e.norm,e.tc)&mask;
+			while (entries[i].index!=-1) i = (i+1)&mask;
+			entries[i] = e;
+		}
+	}
+	
+	std::vector<Entry> entries; // size is always a power of 2
+	size_t count = 0;
+};
 
-Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
+// converts obj elements into indexed triangles, sharing the vertexes that have
+// the same position, normal and texture coordinates
+struct GeometryBuilder {
+	const std::vector<glm::vec3> &positions;
+	const std::vector<glm::vec3> &normals;
+	const std::vector<glm::vec2> &tex_coords;
 	Geometry g;
-	std::unordered_map<std::tuple<int,int,int>,int> map;
-	auto addVertex = [&g,&obj,&map](const ObjMesh::Element &e, int inode) {
-		auto t = std::make_tuple(e.pos[inode],e.norms[inode],e.tcs[inode]);
-		auto p = map.insert({t,g.positions.size()});
+	VertexTable map;
+	
+	GeometryBuilder(const std::vector<glm::vec3> &positions, 
+					const std::vector<glm::vec3> &normals,
+					const std::vector<glm::vec2> &tex_coords)
+		: positions(positions), normals(normals), tex_coords(tex_coords) { }
+	
+	void addVertex(const ObjMesh::Element &e, int inode) {
+		auto p = map.insert(e.pos[inode],e.norms[inode],e.tcs[inode],g.positions.size());
 		if (p.second) {
-			g.positions.push_back(obj.positions[e.pos[inode]]);
-			if (e.norms[inode]!=-1) g.normals.push_back(obj.normals[e.norms[inode]]);
-			if (e.tcs[inode]!=-1) g.tex_coords.push_back(obj.tex_coords[e.tcs[inode]]);
+			g.positions.push_back(positions[e.pos[inode]]);
+			if (e.norms[inode]!=-1) g.normals.push_back(normals[e.norms[inode]]);
+			if (e.tcs[inode]!=-1) g.tex_coords.push_back(tex_coords[e.tcs[inode]]);
 		}
-		g.triangles.push_back(p.first->second);
-	};
-	for(const ObjMesh::Element &e : part.elements) {
+		g.triangles.push_back(p.first);
+	}
+	
+	void addElement(const ObjMesh::Element &e) {
 		addVertex(e,0); addVertex(e,1); addVertex(e,2);
-		if (e.pos[3]==-1) continue;
+		if (e.pos[3]==-1) return;
 		addVertex(e,0); addVertex(e,2); addVertex(e,3);
 	}
-	return g;
+	
+	void clear() {
+		g = Geometry();
+		map.clear();
+	}
+};
+
+}
+
+Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
+	GeometryBuilder builder(obj.positions,obj.normals,obj.tex_coords);
+	builder.map.reserve(part.elements.size());
+	for(const ObjMesh::Element &e : part.elements)
+		builder.addElement(e);
+	return std::move(builder.g);
 }
 
 Geometry toGeometry(const ObjMesh &obj, int ipart) {
@@ -220,3 +471,91 @@ const ObjMesh::Part &ObjMesh::getPart(const std::string &name) const {
 	return *it;
 }
 
+ObjStream::ObjStream(const std::string &full_path) : file(full_path) {
+	cg_info( "Reading obj file (streaming): " + full_path + "..." );
+	cg_assert(file.isOk(),"Could not open obj file");
+	std::string path = extractFolder(full_path);
+	
+	// same rules as readObj for creating/naming parts, but only the faces
+	// are counted, and the offset of the line that starts each part is saved
+	std::map<std::string,Material> materials_lib;
+	std::string current_name;
+	auto newPart = [&](size_t offset) {
+		parts.push_back({});
+		part_starts.push_back(offset);
+	};
+	forEachLine(file,[&](const char *p, const char *end, size_t offset) {
+		if (p==end or *p=='#' or *p=='\r') return;
+		if (lineStartsWith(p,end,"o ")) {
+			newPart(offset);
+			current_name = parts.back().name = readArg(p+2,end);
+		} else if (lineStartsWith(p,end,"mtllib ")) {
+			materials_lib = loadMaterialsLib(path,readArg(p+7,end));
+		} else {
+			if (parts.empty()) newPart(offset);
+			if (lineStartsWith(p,end,"v ")) {
+				positions.push_back(readVec3(p+2));
+			} else if (lineStartsWith(p,end,"vn ")) {
+				normals.push_back(readVec3(p+3));
+			} else if (lineStartsWith(p,end,"vt ")) {
+				tex_coords.push_back(readVec2(p+3));
+			} else if (lineStartsWith(p,end,"f ")) {
+				++parts.back().faces;
+			} else if (lineStartsWith(p,end,"usemtl ")) {
+				std::string mat_name = readArg(p+7,end);
+				if (parts.back().faces) newPart(offset);
+				parts.back().name = current_name+":"+mat_name;
+				if (mat_name!="None") {
+					cg_assert(materials_lib.count(mat_name),"Material not found: "+mat_name);
+					parts.back().material = materials_lib[mat_name];
+				}
+			}
+		}
+	});
+	cg_assert(not parts.empty(),"No mesh object found in file");
+}
+
+void ObjStream::generateNormals ( ) {
+	normals.clear();
+	normals.resize(positions.size());
+	forEachLine(file,[&](const char *p, const char *end, size_t) {
+		if (not lineStartsWith(p,end,"f ")) return;
+		ObjMesh::Element e = readFace(p+2,end);
+		for(int i=1;i<3 and e.pos[i+1]!=-1;++i) { // 1 or 2 triangles: 0,i,i+1
+			auto n = glm::cross( (positions[e.pos[i+1]]-positions[e.pos[i]]),
+								 (positions[e.pos[0]]-positions[e.pos[i]]) );
+			normals[e.pos[0]] += n;
+			normals[e.pos[i]] += n;
+			normals[e.pos[i+1]] += n;
+		}
+	});
+	for(auto &n : normals) 
+		if (glm::dot(n,n)!=0) 
+			n = glm::normalize(n);
+	per_position_normals = true;
+}
+
+void ObjStream::readFaces(size_t memory_budget, const std::function<void(int,const Geometry&)> &callback) const {
+	// approximate memory per vertex in the window: attributes + map entries
+	const size_t vertex_bytes = 2*sizeof(glm::vec3)+sizeof(glm::vec2)+2*sizeof(VertexTable::Entry);
+	GeometryBuilder builder(positions,normals,tex_coords);
+	int current_part = -1;
+	auto flush = [&]() {
+		if (not builder.g.positions.empty()) callback(current_part,builder.g);
+		builder.clear();
+	};
+	forEachLine(file,[&](const char *p, const char *end, size_t offset) {
+		while (current_part+1<static_cast<int>(parts.size()) and part_starts[current_part+1]==offset) {
+			flush(); ++current_part;
+			builder.map.reserve(std::min(parts[current_part].faces,memory_budget/vertex_bytes));
+		}
+		if (not lineStartsWith(p,end,"f ")) return;
+		ObjMesh::Element e = readFace(p+2,end);
+		if (per_position_normals)
+			for(int i=0;i<4;++i) e.norms[i] = e.pos[i];
+		builder.addElement(e);
+		if (builder.g.positions.size()*vertex_bytes+builder.g.triangles.size()*sizeof(int)>=memory_budget)
+			flush();
+	});
+	flush();
+}
@@ -0,0 +1,19 @@
+#ifndef SIMPLIFIER_HPP
+#define SIMPLIFIER_HPP
+
+#include "Geometry.hpp"
+
+// reduces the triangles of an indexed geometry to about target_triangles,
+// collapsing edges in the order given by the quadric error metric (Garland &
+// Heckbert) to one of their endpoints, so no new vertexes are created; the
+// vertexes on borders (this includes the boundaries between the parts of a
+// model, each part being a different geometry) and on attribute seams (same
+// position, different normal or texture coordinates) never move; the result
+// has only the vertexes that are still used, and if error is not null it gets
+// an estimate of the distance between the new surface and the original one
+// (the worst root mean squared distance from a collapsed vertex to the
+// planes of the original triangles that were merged into it)
+Geometry simplifyGeometry(const Geometry &geo, size_t target_triangles, float *error=nullptr);
+
+#endif
+
@@ -7,10 +7,14 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include "Model.hpp"
+#include "AssetCache.hpp"
 #include "Window.hpp"
 #include "Callbacks.hpp"
 #include "Debug.hpp"
 #include "Shaders.hpp"
+#include "TextureLoader.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
 
 #define VERSION 20220816
 
@@ -22,7 +26,13 @@ bool rotate = true, wireframe = false, enable_texture = true;
 // extraa callbacks
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods);
 
-int main() {
+// scripted inputs for the benchmark mode
+void benchmarkInput(GLFWwindow *window, int frame);
+
+int main(int argc, char *argv[]) {
+	
+	// "--bench N" runs a headless benchmark instead (see Benchmark.hpp)
+	if (not Benchmark::init(argc,argv)) return 1;
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"CG Demo",true);
@@ -37,28 +47,38 @@ int main() {
 		   shader_wire("shaders/wireframe");
 	
 	// main loop
-	Model model;
+	AssetCache::ModelsHandle models; // the ones already viewed stay in the cache
 	int loaded_model = -1;
 	FrameTimer ftime;
 	do {
 		
+		Profiler::newFrame();
+		if (Benchmark::isActive()) benchmarkInput(window,Benchmark::getFrame());
+		
 		glClear(/*GL_COLOR_BUFFER_BIT|*/GL_DEPTH_BUFFER_BIT);
 		
 		// reload model if necessary
 		if (loaded_model!=current_model) { 
-			model = Model::loadSingle(models_names[current_model]);
+			models = AssetCache::models(models_names[current_model]);
 			loaded_model = current_model;
 		}
+		const Model &model = models->front();
+		
+		// upload some more of the textures that are still loading
+		TextureLoader::update();
 		
 		// auto-rotate
 		double dt = ftime.newFrame();
 		if (rotate) model_angle += static_cast<float>(1.f*dt);
 		
+		// camera and light, for all the shaders
+		setFrameData(glm::vec4{-1.f,1.f,4.f,1.f}, glm::vec3{1.f,1.f,1.f}, 0.35f);
+		
 		// select a shader
 		Shader &shader = [&]()->Shader&{
 			if (wireframe) return shader_wire;
-			if (enable_texture and model.texture.isOk()) {
-				model.texture.bind();
+			if (enable_texture and model.texture) {
+				model.texture->bind();
 				return shader_texture;
 			}
 			return shader_phong;
@@ -66,29 +86,32 @@ int main() {
 		shader.use();
 		setMatrixes(shader);
 		
-		// setup light and material
-		shader.setLight(glm::vec4{-1.f,1.f,4.f,1.f}, glm::vec3{1.f,1.f,1.f}, 0.35f);
-		shader.setMaterial(model.material);
+		// setup material
+		shader.setMaterial(model.material_index);
 		
 		// send geometry
 		shader.setBuffers(model.buffers);
 		glPolygonMode(GL_FRONT_AND_BACK,wireframe?GL_LINE:GL_POINT);
-		model.buffers.draw();
+		{
+			PROFILE_GPU_SCOPE("model");
+			model.buffers.draw();
+		}
 		
 		// settings sub-window
 		window.ImGuiDialog("CG Example",[&](){
 			ImGui::Combo(".obj (O)", &current_model,models_names);		
 			ImGui::Checkbox("Auto-rotate (R)",&rotate);
 			ImGui::Checkbox("Wireframe (W)",&wireframe);
-			if (model.texture.isOk())
+			if (model.texture)
 				ImGui::Checkbox("Use textures (T)",&enable_texture);
+			Profiler::drawImGui();
 		});
 		
 		// finish frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
-	} while( glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
+	} while( Benchmark::nextFrame() && glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window) );
 }
 
 void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, int mods) {
@@ -101,3 +124,9 @@ void keyboardCallback(GLFWwindow* glfw_win, int key, int scancode, int action, i
 		}
 	}
 }
+
+// every model, with and without wireframe (auto-rotate is on)
+void benchmarkInput(GLFWwindow *window, int frame) {
+	if (frame%60==30) keyboardCallback(window,'W',0,GLFW_PRESS,0);
+	if (frame%120==119) keyboardCallback(window,'O',0,GLFW_PRESS,0);
+}